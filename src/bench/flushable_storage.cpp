@@ -0,0 +1,122 @@
+// Copyright (c) DeFi Blockchain Developers
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+
+#include <amount.h>
+#include <bench/bench.h>
+#include <consensus/merkle.h>
+#include <flushablestorage.h>
+#include <random.h>
+
+static constexpr int TXS_PER_BLOCK = 16;
+static constexpr int WRITES_PER_TX = 8;
+
+// account balance like key: prefix + owner script + token id
+static TBytes RandomBalanceKey(FastRandomContext& rng, uint32_t accounts)
+{
+    TBytes key(1 + 25 + 4);
+    key[0] = 'a';
+    auto account = uint32_t(rng.randrange(accounts));
+    memcpy(&key[1], &account, sizeof(account));
+    key[29] = uint8_t(rng.randrange(4));
+    return key;
+}
+
+// Mimics ConnectBlock: a block cache over the tip view and a view per custom tx
+static void FlushableStorageApplyTx(benchmark::State& state)
+{
+    CStorageLevelDB db{"bench_enhancedcs", 8 << 20, true, true};
+    CFlushableStorageKV tip(db);
+    FastRandomContext rng(true);
+    TBytes value(sizeof(CAmount) + 1);
+
+    while (state.KeepRunning()) {
+        CFlushableStorageKV block(static_cast<CStorageKV&>(tip));
+        for (int tx = 0; tx < TXS_PER_BLOCK; ++tx) {
+            CFlushableStorageKV view(static_cast<CStorageKV&>(block));
+            for (int i = 0; i < WRITES_PER_TX; ++i) {
+                auto key = RandomBalanceKey(rng, 10000);
+                view.Read(key, value);
+                value.resize(sizeof(CAmount) + 1);
+                value[0] = uint8_t(i);
+                view.Write(key, value);
+            }
+            view.Flush();
+        }
+        block.Flush();
+        if (tip.SizeEstimate() > (32 << 20)) {
+            tip.Discard();
+        }
+    }
+}
+
+// Ordered scan over a deep view stack, as ForEach does under RPC
+static void FlushableStorageIterate(benchmark::State& state)
+{
+    CStorageLevelDB db{"bench_enhancedcs", 8 << 20, true, true};
+    CFlushableStorageKV tip(db);
+    CFlushableStorageKV block(static_cast<CStorageKV&>(tip));
+    FastRandomContext rng(true);
+    TBytes value(sizeof(CAmount) + 1);
+    for (int i = 0; i < 5000; ++i) {
+        tip.Write(RandomBalanceKey(rng, 100000), value);
+        block.Write(RandomBalanceKey(rng, 100000), value);
+    }
+
+    size_t total = 0;
+    while (state.KeepRunning()) {
+        auto it = block.NewIterator();
+        for (it->Seek(TBytes{'a'}); it->Valid(); it->Next()) {
+            total += it->Value().size();
+        }
+    }
+    assert(total > 0);
+}
+
+// Block state root as of ConnectBlock: dirty keys are rehashed, the rest is cached
+static void FlushableStorageMerkleRoot(benchmark::State& state, uint32_t keys, uint32_t dirty)
+{
+    CStorageLevelDB db{"bench_enhancedcs", 8 << 20, true, true};
+    CFlushableStorageKV view(db);
+    FastRandomContext rng(true);
+    TBytes value(sizeof(CAmount) + 1);
+    for (uint32_t i = 0; i < keys; ++i) {
+        view.Write(RandomBalanceKey(rng, 1000000), value);
+    }
+    auto& buffer = view.GetRaw();
+    std::vector<TBytes> dirtyKeys;
+    for (auto it = buffer.begin(); it != buffer.end() && dirtyKeys.size() < dirty; ++it) {
+        dirtyKeys.push_back(ToBytes(it->first));
+    }
+
+    uint256 root;
+    while (state.KeepRunning()) {
+        for (const auto& key : dirtyKeys) {
+            value[0]++;
+            view.Write(key, value);
+        }
+        root = ComputeMerkleRoot(buffer.EntryHashes());
+    }
+    assert(!root.IsNull());
+}
+
+static void FlushableStorageMerkleRoot1kAll(benchmark::State& state)
+{
+    FlushableStorageMerkleRoot(state, 1000, 1000);
+}
+
+static void FlushableStorageMerkleRoot100kAll(benchmark::State& state)
+{
+    FlushableStorageMerkleRoot(state, 100000, 100000);
+}
+
+static void FlushableStorageMerkleRoot100k1k(benchmark::State& state)
+{
+    FlushableStorageMerkleRoot(state, 100000, 1000);
+}
+
+BENCHMARK(FlushableStorageApplyTx, 200);
+BENCHMARK(FlushableStorageIterate, 50);
+BENCHMARK(FlushableStorageMerkleRoot1kAll, 500);
+BENCHMARK(FlushableStorageMerkleRoot100kAll, 5);
+BENCHMARK(FlushableStorageMerkleRoot100k1k, 20);
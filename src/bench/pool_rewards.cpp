@@ -0,0 +1,53 @@
+// Copyright (c) DeFi Blockchain Developers
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+
+#include <amount.h>
+#include <bench/bench.h>
+#include <masternodes/poolpairs.h>
+#include <random.h>
+
+#include <vector>
+
+static constexpr size_t PROVIDERS = 100000;
+
+// Pool with synthetic providers, their liquidity sums to the total one
+static CAmount ProvidersLiquidity(std::vector<CAmount>& liquidity)
+{
+    FastRandomContext rng(true);
+    CAmount totalLiquidity = 0;
+    liquidity.resize(PROVIDERS);
+    for (auto& amount : liquidity) {
+        amount = CAmount(rng.randrange(1000 * COIN)) + 1;
+        totalLiquidity += amount;
+    }
+    return totalLiquidity;
+}
+
+// One block reward distributed to every provider one by one
+static void PoolRewardsScalar(benchmark::State& state)
+{
+    std::vector<CAmount> liquidity, rewards(PROVIDERS);
+    const auto totalLiquidity = ProvidersLiquidity(liquidity);
+    const CAmount reward = 123 * COIN;
+
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < PROVIDERS; ++i) {
+            rewards[i] = liquidityReward(reward, liquidity[i], totalLiquidity);
+        }
+    }
+}
+
+static void PoolRewardsBatch(benchmark::State& state)
+{
+    std::vector<CAmount> liquidity, rewards(PROVIDERS);
+    const auto totalLiquidity = ProvidersLiquidity(liquidity);
+    const CAmount reward = 123 * COIN;
+
+    while (state.KeepRunning()) {
+        CalculateLiquidityRewards(reward, totalLiquidity, liquidity.data(), rewards.data(), PROVIDERS);
+    }
+}
+
+BENCHMARK(PoolRewardsScalar, 5);
+BENCHMARK(PoolRewardsBatch, 50);
@@ -56,6 +56,14 @@ const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w);
 //    return leveldb::Slice (reinterpret_cast<char const*>(key.data()), key.size());
 //}
 
+/** Per-database leveldb settings, zero keeps the default derived from cache size */
+struct CDBTuning
+{
+    size_t blockSize = 0;
+    size_t writeBufferSize = 0;
+    bool compression = false;
+};
+
 /** Batch of changes queued to be written to a CDBWrapper */
 class CDBBatch
 {
@@ -148,6 +156,7 @@ public:
     bool Valid() const;
 
     void SeekToFirst();
+    void SeekToLast();
 
     template<typename K> void Seek(const K& key) {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
@@ -188,6 +197,20 @@ public:
         return piter->value().size();
     }
 
+    //! Raw key/value memory, valid until the iterator is moved
+    leveldb::Slice GetKeySlice() const {
+        return piter->key();
+    }
+    leveldb::Slice GetValueSlice() const {
+        return piter->value();
+    }
+
+    void SeekSlice(const leveldb::Slice& key) {
+        piter->Seek(key);
+    }
+
+    //! Whether values should be deobfuscated after GetValueSlice
+    bool IsObfuscated() const;
 };
 
 //template<>
@@ -251,15 +274,16 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] tuning      Block size, write buffer size and compression of leveldb.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const CDBTuning& tuning = {});
     ~CDBWrapper();
 
     CDBWrapper(const CDBWrapper&) = delete;
     CDBWrapper& operator=(const CDBWrapper&) = delete;
 
     template <typename K, typename V>
-    bool Read(const K& key, V& value) const
+    bool Read(const K& key, V& value, const leveldb::Snapshot* snapshot = nullptr) const
     {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
@@ -267,8 +291,10 @@ public:
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 //        leveldb::Slice slKey(SliceKey(key));
 
+        leveldb::ReadOptions options = readoptions;
+        options.snapshot = snapshot;
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        leveldb::Status status = pdb->Get(options, slKey, &strValue);
         if (!status.ok()) {
             if (status.IsNotFound())
                 return false;
@@ -294,7 +320,7 @@ public:
     }
 
     template <typename K>
-    bool Exists(const K& key) const
+    bool Exists(const K& key, const leveldb::Snapshot* snapshot = nullptr) const
     {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
@@ -302,8 +328,10 @@ public:
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 //        leveldb::Slice slKey(SliceKey(key));
 
+        leveldb::ReadOptions options = readoptions;
+        options.snapshot = snapshot;
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        leveldb::Status status = pdb->Get(options, slKey, &strValue);
         if (!status.ok()) {
             if (status.IsNotFound())
                 return false;
@@ -338,9 +366,20 @@ public:
         return WriteBatch(batch, true);
     }
 
-    CDBIterator *NewIterator()
+    CDBIterator *NewIterator(const leveldb::Snapshot* snapshot = nullptr)
+    {
+        leveldb::ReadOptions options = iteroptions;
+        options.snapshot = snapshot;
+        return new CDBIterator(*this, pdb->NewIterator(options));
+    }
+
+    /**
+     * Return the current state of the database, it's not changed by later writes.
+     * Released with the last reference, which must not outlive the database.
+     */
+    std::shared_ptr<const leveldb::Snapshot> GetSnapshot() const
     {
-        return new CDBIterator(*this, pdb->NewIterator(iteroptions));
+        return {pdb->GetSnapshot(), [this](const leveldb::Snapshot* snapshot) { pdb->ReleaseSnapshot(snapshot); }};
     }
 
     /**
@@ -6,16 +6,75 @@
 #define DEFI_FLUSHABLESTORAGE_H
 
 #include <dbwrapper.h>
+#include <hash.h>
+#include <array>
+#include <condition_variable>
+#include <cstring>
 #include <functional>
+#include <limits>
+#include <list>
 #include <optional.h>
 #include <map>
 #include <memusage.h>
+#include <span.h>
+#include <sync.h>
+#include <thread>
+#include <unordered_map>
+#include <util/bytevectorhash.h>
+#include <util/parallel.h>
+#include <util/time.h>
 
 #include <boost/thread.hpp>
 
 using TBytes = std::vector<unsigned char>;
+using TBytesView = Span<const unsigned char>;
 using MapKV = std::map<TBytes, Optional<TBytes>>;
 
+inline TBytesView MakeView(const TBytes& bytes) {
+    return {bytes.data(), static_cast<std::ptrdiff_t>(bytes.size())};
+}
+
+inline TBytes ToBytes(TBytesView view) {
+    return TBytes(view.begin(), view.end());
+}
+
+// memcmp based, same order as leveldb BytewiseComparator and std::less<TBytes>
+inline int CompareBytes(TBytesView a, TBytesView b) {
+    auto size = std::min(a.size(), b.size());
+    auto cmp = size ? memcmp(a.data(), b.data(), size) : 0;
+    if (cmp == 0) {
+        return a.size() < b.size() ? -1 : a.size() > b.size() ? 1 : 0;
+    }
+    return cmp;
+}
+
+struct LessBytes {
+    bool operator()(TBytesView a, TBytesView b) const {
+        return CompareBytes(a, b) < 0;
+    }
+};
+
+struct GreaterBytes {
+    bool operator()(TBytesView a, TBytesView b) const {
+        return CompareBytes(a, b) > 0;
+    }
+};
+
+inline bool StartsWith(TBytesView key, const TBytes& prefix) {
+    return size_t(key.size()) >= prefix.size() && (prefix.empty() || memcmp(key.data(), prefix.data(), prefix.size()) == 0);
+}
+
+// first key after all keys starting with prefix, empty if there is no such key
+inline TBytes PrefixUpperBound(TBytes prefix) {
+    while (!prefix.empty() && prefix.back() == 0xff) {
+        prefix.pop_back();
+    }
+    if (!prefix.empty()) {
+        ++prefix.back();
+    }
+    return prefix;
+}
+
 template<typename T>
 static TBytes DbTypeToBytes(const T& value) {
     TBytes bytes;
@@ -24,12 +83,25 @@ static TBytes DbTypeToBytes(const T& value) {
     return bytes;
 }
 
+template<typename T>
+static bool BytesToDbType(TBytesView bytes, T& value) {
+    try {
+        SpanReader stream(SER_DISK, CLIENT_VERSION, bytes);
+        stream >> value;
+//        assert(stream.size() == 0); // will fail with partial key matching
+    }
+    catch (std::ios_base::failure&) {
+        return false;
+    }
+    return true;
+}
+
+// types with own VectorReader serialization (like GovVariable) are read from TBytes only
 template<typename T>
 static bool BytesToDbType(const TBytes& bytes, T& value) {
     try {
         VectorReader stream(SER_DISK, CLIENT_VERSION, bytes, 0);
         stream >> value;
-//        assert(stream.size() == 0); // will fail with partial key matching
     }
     catch (std::ios_base::failure&) {
         return false;
@@ -38,6 +110,10 @@ static bool BytesToDbType(const TBytes& bytes, T& value) {
 }
 
 // Key-Value storage iterator interface
+// Key and Value are views into storage memory, valid until the iterator is moved
+// Iterator created with a prefix is valid only on keys starting with it.
+// Next/Prev of an exhausted iterator re-enter the range from the side it was left,
+// it is a no-op otherwise
 class CStorageKVIterator {
 public:
     virtual ~CStorageKVIterator() = default;
@@ -45,8 +121,8 @@ public:
     virtual void Next() = 0;
     virtual void Prev() = 0;
     virtual bool Valid() = 0;
-    virtual TBytes Key() = 0;
-    virtual TBytes Value() = 0;
+    virtual TBytesView Key() = 0;
+    virtual TBytesView Value() = 0;
 };
 
 // Key-Value storage interface
@@ -57,7 +133,10 @@ public:
     virtual bool Write(const TBytes& key, const TBytes& value) = 0;
     virtual bool Erase(const TBytes& key) = 0;
     virtual bool Read(const TBytes& key, TBytes& value) const = 0;
-    virtual std::unique_ptr<CStorageKVIterator> NewIterator() = 0;
+    virtual std::unique_ptr<CStorageKVIterator> NewIterator(const TBytes& prefix) = 0;
+    std::unique_ptr<CStorageKVIterator> NewIterator() {
+        return NewIterator(TBytes{});
+    }
     virtual size_t SizeEstimate() const = 0;
     virtual void Discard() = 0;
     virtual bool Flush() = 0;
@@ -87,158 +166,629 @@ inline RawTBytes<T> refTBytes(T& val) {
     return RawTBytes<T>{val};
 }
 
+inline TBytesView MakeView(const leveldb::Slice& slice) {
+    return {reinterpret_cast<const unsigned char*>(slice.data()), static_cast<std::ptrdiff_t>(slice.size())};
+}
+
 // LevelDB glue layer Iterator
 class CStorageLevelDBIterator : public CStorageKVIterator {
 public:
-    explicit CStorageLevelDBIterator(std::unique_ptr<CDBIterator>&& it) : it{std::move(it)} { }
+    explicit CStorageLevelDBIterator(std::unique_ptr<CDBIterator>&& it, const TBytes& prefix = {})
+        : it{std::move(it)}, prefix(prefix), upper(PrefixUpperBound(prefix)) {
+        obfuscated = this->it->IsObfuscated();
+    }
     CStorageLevelDBIterator(const CStorageLevelDBIterator&) = delete;
     ~CStorageLevelDBIterator() override = default;
 
     void Seek(const TBytes& key) override {
-        it->Seek(refTBytes(key)); // lower_bound in fact
+        reversed = false;
+        SeekTo(CompareBytes(MakeView(key), MakeView(prefix)) < 0 ? prefix : key); // lower_bound in fact
     }
     void Next() override {
-        it->Next();
+        if (Valid()) {
+            it->Next();
+        } else if (reversed) {
+            SeekTo(prefix);
+        }
+        reversed = false;
     }
     void Prev() override {
-        it->Prev();
+        if (Valid()) {
+            it->Prev();
+        } else if (!reversed) {
+            // leveldb has no reverse seek, step back from the range end
+            if (!upper.empty()) {
+                SeekTo(upper);
+            }
+            if (upper.empty() || !it->Valid()) {
+                it->SeekToLast();
+            } else {
+                it->Prev();
+            }
+        }
+        reversed = true;
     }
     bool Valid() override {
-        return it->Valid();
+        // leveldb has no upper bound, stop on the first foreign key instead
+        return it->Valid() && StartsWith(Key(), prefix);
     }
-    TBytes Key() override {
-        TBytes key;
-        auto rawKey = refTBytes(key);
-        return it->GetKey(rawKey) ? key : TBytes{};
+    TBytesView Key() override {
+        return MakeView(it->GetKeySlice());
     }
-    TBytes Value() override {
-        TBytes value;
+    TBytesView Value() override {
+        if (!obfuscated) {
+            return MakeView(it->GetValueSlice());
+        }
         auto rawValue = refTBytes(value);
-        return it->GetValue(rawValue) ? value : TBytes{};
+        return it->GetValue(rawValue) ? MakeView(value) : TBytesView{};
     }
 private:
+    void SeekTo(const TBytes& key) {
+        it->SeekSlice({reinterpret_cast<const char*>(key.data()), key.size()});
+    }
     std::unique_ptr<CDBIterator> it;
+    const TBytes prefix;
+    const TBytes upper;
+    bool reversed = false; // last move was backward
+    bool obfuscated;
+    TBytes value; // deobfuscated copy, if needed
 };
 
-// LevelDB glue layer storage
-class CStorageLevelDB : public CStorageKV {
+// LRU cache of values read from disk, missing keys are cached as well.
+// Sized by memory usage, zero size disables it
+class CStorageReadCache {
 public:
-    explicit CStorageLevelDB(const fs::path& dbName, std::size_t cacheSize, bool fMemory = false, bool fWipe = false)
-        : db{dbName, cacheSize, fMemory, fWipe}, batch(db) {}
-    ~CStorageLevelDB() override = default;
+    explicit CStorageReadCache(size_t maxSize) : maxSize(maxSize) {}
+    CStorageReadCache(const CStorageReadCache&) = delete;
 
-    bool Exists(const TBytes& key) const override {
-        return db.Exists(refTBytes(key));
-    }
-    bool Write(const TBytes& key, const TBytes& value) override {
-        batch.Write(refTBytes(key), refTBytes(value));
+    // true if key is cached, value is empty for missing key
+    bool Get(const TBytes& key, Optional<TBytes>& value) {
+        if (!maxSize) {
+            return false;
+        }
+        LOCK(cs);
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return false;
+        }
+        entries.splice(entries.begin(), entries, it->second);
+        value = it->second->second;
         return true;
     }
-    bool Erase(const TBytes& key) override {
-        begin.empty() ? (begin = key) : (end = key);
-        batch.Erase(refTBytes(key));
+    void Put(const TBytes& key, const Optional<TBytes>& value) {
+        if (!maxSize) {
+            return;
+        }
+        LOCK(cs);
+        if (index.count(key)) {
+            return;
+        }
+        entries.emplace_front(key, value);
+        index.emplace(key, entries.begin());
+        usage += EntryUsage(entries.front());
+        while (usage > maxSize) {
+            usage -= EntryUsage(entries.back());
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+    void Drop(const TBytes& key) {
+        if (!maxSize) {
+            return;
+        }
+        LOCK(cs);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            usage -= EntryUsage(*it->second);
+            entries.erase(it->second);
+            index.erase(it);
+        }
+    }
+    void Clear() {
+        LOCK(cs);
+        index.clear();
+        entries.clear();
+        usage = 0;
+    }
+    size_t DynamicUsage() const {
+        LOCK(cs);
+        return usage;
+    }
+    size_t MaxSize() const {
+        return maxSize;
+    }
+
+private:
+    using Entry = std::pair<TBytes, Optional<TBytes>>;
+
+    // key is held twice, by list node and index node
+    static size_t EntryUsage(const Entry& entry) {
+        return 2 * memusage::DynamicUsage(entry.first)
+            + (entry.second ? memusage::DynamicUsage(*entry.second) : 0)
+            + memusage::MallocUsage(sizeof(Entry) + 2 * sizeof(void*))
+            + memusage::MallocUsage(sizeof(std::pair<TBytes, void*>) + sizeof(void*))
+            + sizeof(void*);
+    }
+
+    const size_t maxSize;
+    mutable Mutex cs;
+    std::list<Entry> entries; // most recently used first
+    std::unordered_map<TBytes, std::list<Entry>::iterator, ByteVectorHash> index;
+    size_t usage = 0;
+};
+
+// Flashable storage
+
+// Bump allocator backing the dirty set of a single flushable layer.
+// Memory is handed out from growing chunks and released at once on Clear
+class CStorageArena {
+public:
+    static constexpr size_t MinChunkSize = 4 * 1024;
+    static constexpr size_t MaxChunkSize = 256 * 1024;
+
+    CStorageArena() = default;
+    CStorageArena(const CStorageArena&) = delete;
+    CStorageArena& operator=(const CStorageArena&) = delete;
+
+    void* Allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        auto ptr = AlignUp(pos, align);
+        if (!ptr || ptr + size > last) {
+            if (size + align > MaxChunkSize / 4) {
+                // oversized values get own chunk, current one is still in use
+                return AlignUp(NewChunk(size + align), align);
+            }
+            pos = NewChunk(nextChunkSize);
+            last = pos + nextChunkSize;
+            if (nextChunkSize < MaxChunkSize) {
+                nextChunkSize *= 2;
+            }
+            ptr = AlignUp(pos, align);
+        }
+        pos = ptr + size;
+        return ptr;
+    }
+    TBytesView Copy(const TBytes& bytes) {
+        auto ptr = static_cast<unsigned char*>(Allocate(bytes.size(), 1));
+        if (!bytes.empty()) {
+            memcpy(ptr, bytes.data(), bytes.size());
+        }
+        return {ptr, static_cast<std::ptrdiff_t>(bytes.size())};
+    }
+    void Clear() {
+        chunks.clear();
+        pos = last = nullptr;
+        nextChunkSize = MinChunkSize;
+        usage = 0;
+    }
+    size_t DynamicUsage() const {
+        return usage + memusage::DynamicUsage(chunks);
+    }
+    size_t Chunks() const {
+        return chunks.size();
+    }
+
+private:
+    static unsigned char* AlignUp(unsigned char* ptr, size_t align) {
+        auto value = reinterpret_cast<uintptr_t>(ptr);
+        return reinterpret_cast<unsigned char*>((value + align - 1) & ~uintptr_t(align - 1));
+    }
+    unsigned char* NewChunk(size_t size) {
+        chunks.emplace_back(std::unique_ptr<unsigned char[]>(new unsigned char[size]), size);
+        usage += memusage::MallocUsage(size);
+        return chunks.back().first.get();
+    }
+
+    std::vector<std::pair<std::unique_ptr<unsigned char[]>, size_t>> chunks;
+    unsigned char* pos = nullptr;
+    unsigned char* last = nullptr;
+    size_t nextChunkSize = MinChunkSize;
+    size_t usage = 0;
+};
+
+// STL allocator on top of CStorageArena, nodes are freed with the arena
+template<typename T>
+class CArenaAllocator {
+    template<typename U>
+    friend class CArenaAllocator;
+    CStorageArena* arena;
+
+public:
+    using value_type = T;
+
+    explicit CArenaAllocator(CStorageArena& arena) noexcept : arena(&arena) {}
+    template<typename U>
+    CArenaAllocator(const CArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena->Allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T*, size_t) noexcept {}
+
+    template<typename U>
+    bool operator==(const CArenaAllocator<U>& other) const noexcept {
+        return arena == other.arena;
+    }
+    template<typename U>
+    bool operator!=(const CArenaAllocator<U>& other) const noexcept {
+        return arena != other.arena;
+    }
+};
+
+// Erased key ranges waiting for compaction, one range per table (first key byte).
+// Ranges of a table are merged, tables are taken in round robin order
+class CStorageCompactionQueue {
+public:
+    using Range = std::pair<TBytes, TBytes>;
+    using Ranges = std::map<unsigned char, Range>;
+
+    struct Stats {
+        uint64_t added = 0;     // ranges added by flushes
+        uint64_t compacted = 0; // ranges compacted
+        int64_t time = 0;       // microseconds spent in compaction
+        size_t pending = 0;     // ranges waiting
+    };
+
+    // extends the range of key's table
+    static void AddKey(Ranges& ranges, const TBytes& key) {
+        if (key.empty()) {
+            return;
+        }
+        auto it = ranges.find(key[0]);
+        if (it == ranges.end()) {
+            ranges.emplace(key[0], Range{key, key});
+        } else if (key < it->second.first) {
+            it->second.first = key;
+        } else if (it->second.second < key) {
+            it->second.second = key;
+        }
+    }
+    void Push(const Ranges& ranges) {
+        LOCK(cs);
+        for (const auto& range : ranges) {
+            ++stats.added;
+            auto it = pending.find(range.first);
+            if (it == pending.end()) {
+                pending.insert(range);
+                continue;
+            }
+            if (range.second.first < it->second.first) {
+                it->second.first = range.second.first;
+            }
+            if (it->second.second < range.second.second) {
+                it->second.second = range.second.second;
+            }
+        }
+    }
+    bool Pop(Range& range) {
+        LOCK(cs);
+        if (pending.empty()) {
+            return false;
+        }
+        auto it = pending.lower_bound(next);
+        if (it == pending.end()) {
+            it = pending.begin();
+        }
+        next = it->first + 1; // wraps around after the last table
+        range = std::move(it->second);
+        pending.erase(it);
         return true;
     }
-    bool Read(const TBytes& key, TBytes& value) const override {
-        auto rawVal = refTBytes(value);
-        return db.Read(refTBytes(key), rawVal);
+    void Done(int64_t time) {
+        LOCK(cs);
+        ++stats.compacted;
+        stats.time += time;
     }
-    bool Flush() override { // Commit batch
-        auto result = db.WriteBatch(batch);
-        batch.Clear();
-        // prevent db fragmentation
-        if (!begin.empty() && !end.empty()) {
-            db.CompactRange(refTBytes(begin), refTBytes(end));
-        }
-        end.clear();
-        begin.clear();
+    Stats GetStats() const {
+        LOCK(cs);
+        auto result = stats;
+        result.pending = pending.size();
         return result;
     }
-    void Discard() override {
-        end.clear();
-        begin.clear();
-        batch.Clear();
+
+private:
+    mutable Mutex cs;
+    Ranges pending GUARDED_BY(cs);
+    unsigned char next GUARDED_BY(cs) = 0;
+    Stats stats GUARDED_BY(cs);
+};
+
+// Bloom filter of the keys of a big write buffer, a read of missing key
+// skips the layer without the index lookup
+class CStorageKeyFilter {
+public:
+    static constexpr size_t BitsPerKey = 10;
+    static constexpr uint32_t Probes = 6; // ~1% false positives
+
+    bool Active() const {
+        return !bits.empty();
     }
-    size_t SizeEstimate() const override {
-        return batch.SizeEstimate();
+    size_t Capacity() const {
+        return capacity;
     }
-    std::unique_ptr<CStorageKVIterator> NewIterator() override {
-        return MakeUnique<CStorageLevelDBIterator>(std::unique_ptr<CDBIterator>(db.NewIterator()));
+    // drops all keys, they should be inserted again
+    void Reset(size_t newCapacity) {
+        capacity = newCapacity;
+        bits.assign((capacity * BitsPerKey + 63) / 64, 0);
     }
-    bool IsEmpty() {
-        return db.IsEmpty();
+    void Insert(TBytesView key) {
+        uint32_t h1, h2;
+        Hash(key, h1, h2);
+        for (uint32_t i = 0; i < Probes; ++i, h1 += h2) {
+            auto bit = h1 % (bits.size() * 64);
+            bits[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+    }
+    bool MayContain(TBytesView key) const {
+        uint32_t h1, h2;
+        Hash(key, h1, h2);
+        for (uint32_t i = 0; i < Probes; ++i, h1 += h2) {
+            auto bit = h1 % (bits.size() * 64);
+            if (!(bits[bit / 64] & (uint64_t(1) << (bit % 64)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+    void Clear() {
+        capacity = 0;
+        bits.clear();
+        bits.shrink_to_fit();
+    }
+    size_t DynamicUsage() const {
+        return memusage::DynamicUsage(bits);
     }
 
 private:
-    TBytes end;
-    TBytes begin;
-    CDBWrapper db;
-    CDBBatch batch;
+    // double hashing, see Kirsch and Mitzenmacher
+    static void Hash(TBytesView key, uint32_t& h1, uint32_t& h2) {
+        h1 = MurmurHash3(0, key);
+        h2 = MurmurHash3(0x9e3779b9, key) | 1;
+    }
+
+    size_t capacity = 0;
+    std::vector<uint64_t> bits;
 };
 
-// Flashable storage
+// Sorted write buffer of a flushable layer.
+// Keys and values are stored inline in the layer arena, the index nodes are
+// allocated from it as well, so a write does not touch the heap.
+// Erased keys are kept as empty values to shadow the parent storage.
+// Node based index is kept on purpose: iterators stay valid while the
+// layer is written during ForEach callbacks.
+// Entry hashes are cached once requested and dropped when the entry changes.
+// Buffers above MinFilterKeys keep a key filter for lookups of missing keys.
+class CStorageWriteBuffer {
+    using Entry = std::pair<const TBytesView, Optional<TBytesView>>;
+    using Index = std::map<TBytesView, Optional<TBytesView>, LessBytes, CArenaAllocator<Entry>>;
+    using HashEntry = std::pair<const TBytesView, uint256>;
+    using HashIndex = std::map<TBytesView, uint256, LessBytes, CArenaAllocator<HashEntry>>;
+
+public:
+    using const_iterator = Index::const_iterator;
+    using const_reverse_iterator = Index::const_reverse_iterator;
+
+    // below that hashing is faster than starting a thread
+    static constexpr size_t MinHashesPerThread = 1024;
+    // below that index lookup is as cheap as filter check
+    static constexpr size_t MinFilterKeys = 64;
+
+    CStorageWriteBuffer() : index(LessBytes{}, CArenaAllocator<Entry>{arena}), hashes(LessBytes{}, CArenaAllocator<HashEntry>{arena}) {}
+    CStorageWriteBuffer(const CStorageWriteBuffer&) = delete;
+    CStorageWriteBuffer& operator=(const CStorageWriteBuffer&) = delete;
+
+    void Write(const TBytes& key, const TBytes& value) {
+        DropHash(key);
+        auto it = index.find(MakeView(key));
+        if (it == index.end()) {
+            OnInsert(index.emplace(arena.Copy(key), arena.Copy(value)).first->first);
+        } else if (it->second && size_t(it->second->size()) >= value.size()) {
+            // overwrite in place, it's the arena own memory
+            auto data = const_cast<unsigned char*>(it->second->data());
+            if (!value.empty()) {
+                memcpy(data, value.data(), value.size());
+            }
+            it->second = TBytesView{data, static_cast<std::ptrdiff_t>(value.size())};
+        } else {
+            it->second = arena.Copy(value);
+        }
+    }
+    void Erase(const TBytes& key) {
+        DropHash(key);
+        auto it = index.find(MakeView(key));
+        if (it == index.end()) {
+            OnInsert(index.emplace(arena.Copy(key), Optional<TBytesView>{}).first->first);
+        } else {
+            it->second = boost::none;
+        }
+    }
+    // deep copy of the entries, cached hashes are not copied
+    std::unique_ptr<CStorageWriteBuffer> Clone() const {
+        auto copy = MakeUnique<CStorageWriteBuffer>();
+        for (const auto& entry : index) {
+            if (entry.second) {
+                copy->Write(ToBytes(entry.first), ToBytes(*entry.second));
+            } else {
+                copy->Erase(ToBytes(entry.first));
+            }
+        }
+        return copy;
+    }
+    void Clear() {
+        filter.Clear();
+        hashes.clear();
+        index.clear();
+        arena.Clear();
+    }
+
+    // Hash2(key, value) of every entry in key order, erased keys have empty value
+    std::vector<uint256> EntryHashes() {
+        std::vector<uint256> result(index.size());
+        std::vector<std::pair<size_t, const_iterator>> missing;
+        // cached keys are a subset of the index keys
+        auto cached = hashes.cbegin();
+        size_t pos = 0;
+        for (auto it = index.cbegin(); it != index.cend(); ++it, ++pos) {
+            if (cached != hashes.cend() && CompareBytes(cached->first, it->first) == 0) {
+                result[pos] = cached->second;
+                ++cached;
+            } else {
+                missing.emplace_back(pos, it);
+            }
+        }
+        ParallelFor(missing.size(), MinHashesPerThread, [&](size_t begin, size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                const auto& entry = *missing[i].second;
+                result[missing[i].first] = Hash2(entry.first, entry.second ? *entry.second : TBytesView{});
+            }
+        });
+        for (const auto& entry : missing) {
+            hashes.emplace(entry.second->first, result[entry.first]);
+        }
+        return result;
+    }
+
+    const_iterator find(const TBytes& key) const {
+        if (filter.Active() && !filter.MayContain(MakeView(key))) {
+            return index.end();
+        }
+        return index.find(MakeView(key));
+    }
+    const_iterator lower_bound(const TBytes& key) const { return index.lower_bound(MakeView(key)); }
+    const_iterator begin() const { return index.begin(); }
+    const_iterator end() const { return index.end(); }
+    const_reverse_iterator rbegin() const { return index.rbegin(); }
+    const_reverse_iterator rend() const { return index.rend(); }
+    bool empty() const { return index.empty(); }
+    size_t size() const { return index.size(); }
+
+    size_t DynamicUsage() const {
+        return arena.DynamicUsage() + filter.DynamicUsage();
+    }
+    const CStorageArena& GetArena() const {
+        return arena;
+    }
+    const CStorageKeyFilter& GetFilter() const {
+        return filter;
+    }
+
+private:
+    void OnInsert(TBytesView key) {
+        if (index.size() < MinFilterKeys) {
+            return;
+        }
+        if (index.size() <= filter.Capacity()) {
+            filter.Insert(key);
+            return;
+        }
+        // grow twice, keys are inserted again
+        filter.Reset(2 * index.size());
+        for (const auto& entry : index) {
+            filter.Insert(entry.first);
+        }
+    }
+    void DropHash(const TBytes& key) {
+        if (!hashes.empty()) {
+            hashes.erase(MakeView(key));
+        }
+    }
+
+    CStorageArena arena; // should outlive indexes
+    Index index;
+    HashIndex hashes;
+    CStorageKeyFilter filter;
+};
 
 // Flushable Key-Value Storage Iterator
+// Parent iterator is bounded by the same prefix, write buffer entries out of it
+// are treated as its end, they are not copied or checked against the parent
 class CFlushableStorageKVIterator : public CStorageKVIterator {
 public:
-    explicit CFlushableStorageKVIterator(std::unique_ptr<CStorageKVIterator>&& pIt, MapKV& map) : map(map), pIt(std::move(pIt)) {
+    explicit CFlushableStorageKVIterator(std::unique_ptr<CStorageKVIterator>&& pIt, const CStorageWriteBuffer& map, const TBytes& prefix = {})
+        : map(map), pIt(std::move(pIt)), prefix(prefix), upper(PrefixUpperBound(prefix)) {
         itState = Invalid;
+        mIt = map.end();
     }
     CFlushableStorageKVIterator(const CFlushableStorageKVIterator&) = delete;
     ~CFlushableStorageKVIterator() override = default;
 
     void Seek(const TBytes& key) override {
-        pIt->Seek(key);
-        mIt = Advance(map.lower_bound(key), map.end(), std::greater<TBytes>{}, {});
+        const auto& start = CompareBytes(MakeView(key), MakeView(prefix)) < 0 ? prefix : key;
+        pIt->Seek(start);
+        prevKey.clear();
+        reversed = false;
+        mIt = Advance(map.lower_bound(start), map.end(), GreaterBytes{});
     }
     void Next() override {
-        assert(Valid());
-        mIt = Advance(mIt, map.end(), std::greater<TBytes>{}, Key());
+        if (Valid()) {
+            SetPrevKey(Key());
+        } else if (reversed) {
+            prevKey.clear();
+            mIt = map.lower_bound(prefix);
+        } else {
+            return;
+        }
+        // parent could leave the range before us
+        if (!pIt->Valid()) {
+            pIt->Next();
+        }
+        reversed = false;
+        mIt = Advance(mIt, map.end(), GreaterBytes{});
     }
     void Prev() override {
-        assert(Valid());
         auto tmp = mIt;
-        if (tmp != map.end()) {
-            ++tmp;
-        }
-        auto it = std::reverse_iterator<decltype(tmp)>(tmp);
-        auto end = Advance(it, map.rend(), std::less<TBytes>{}, Key());
-        if (end == map.rend()) {
-            mIt = map.begin();
+        if (Valid()) {
+            SetPrevKey(Key());
+            if (tmp != map.end()) {
+                ++tmp;
+            }
+        } else if (!reversed) {
+            prevKey.clear();
+            tmp = upper.empty() ? map.end() : map.lower_bound(upper);
         } else {
-            auto offset = mIt == map.end() ? 1 : 0;
-            std::advance(mIt, -std::distance(it, end) - offset);
+            return;
+        }
+        if (!pIt->Valid()) {
+            pIt->Prev();
         }
+        reversed = true;
+        auto end = Advance(CStorageWriteBuffer::const_reverse_iterator(tmp), map.rend(), LessBytes{});
+        mIt = end == map.rend() ? map.begin() : std::prev(end.base());
     }
     bool Valid() override {
         return itState != Invalid;
     }
-    TBytes Key() override {
+    TBytesView Key() override {
         assert(Valid());
         return itState == Map ? mIt->first : pIt->Key();
     }
-    TBytes Value() override {
+    TBytesView Value() override {
         assert(Valid());
         return itState == Map ? *mIt->second : pIt->Value();
     }
 private:
+    // copied, parent's view is invalidated on move
+    void SetPrevKey(TBytesView key) {
+        prevKey.assign(key.begin(), key.end());
+    }
     template<typename TIterator, typename Compare>
-    TIterator Advance(TIterator it, TIterator end, Compare comp, TBytes prevKey) {
-
-        while (it != end || pIt->Valid()) {
-            while (it != end && (!pIt->Valid() || !comp(it->first, pIt->Key()))) {
-                if (prevKey.empty() || comp(it->first, prevKey)) {
+    TIterator Advance(TIterator it, TIterator end, Compare comp) {
+        auto mapValid = [&]() {
+            return it != end && InRange(it);
+        };
+        while (mapValid() || pIt->Valid()) {
+            while (mapValid() && (!pIt->Valid() || !comp(it->first, pIt->Key()))) {
+                if (prevKey.empty() || comp(it->first, MakeView(prevKey))) {
                     if (it->second) {
                         itState = Map;
                         return it;
                     } else {
-                        prevKey = it->first;
+                        SetPrevKey(it->first);
                     }
                 }
                 ++it;
             }
             if (pIt->Valid()) {
-                if (prevKey.empty() || comp(pIt->Key(), prevKey)) {
+                if (prevKey.empty() || comp(pIt->Key(), MakeView(prevKey))) {
                     itState = Parent;
                     return it;
                 }
@@ -248,81 +798,580 @@ private:
         itState = Invalid;
         return it;
     }
-    void NextParent(MapKV::const_iterator&) {
+    bool InRange(const CStorageWriteBuffer::const_iterator& it) const {
+        return upper.empty() || CompareBytes(it->first, MakeView(upper)) < 0;
+    }
+    bool InRange(const CStorageWriteBuffer::const_reverse_iterator& it) const {
+        return CompareBytes(it->first, MakeView(prefix)) >= 0;
+    }
+    void NextParent(CStorageWriteBuffer::const_iterator&) {
         pIt->Next();
     }
-    void NextParent(std::reverse_iterator<MapKV::const_iterator>&) {
+    void NextParent(CStorageWriteBuffer::const_reverse_iterator&) {
         pIt->Prev();
     }
-    const MapKV& map;
-    MapKV::const_iterator mIt;
+    const CStorageWriteBuffer& map;
+    CStorageWriteBuffer::const_iterator mIt;
     std::unique_ptr<CStorageKVIterator> pIt;
+    const TBytes prefix;
+    const TBytes upper;
+    TBytes prevKey;
+    bool reversed = false; // last move was backward
     enum IteratorState { Invalid, Map, Parent } itState;
 };
 
+// Iterator over tables stored in different leveldb instances, walks them in key order
+class CStorageTablesIterator : public CStorageKVIterator {
+public:
+    using TableIterator = std::function<std::unique_ptr<CStorageKVIterator>(unsigned char)>;
+
+    explicit CStorageTablesIterator(TableIterator newIterator) : newIterator(std::move(newIterator)) {}
+    CStorageTablesIterator(const CStorageTablesIterator&) = delete;
+    ~CStorageTablesIterator() override = default;
+
+    void Seek(const TBytes& key) override {
+        reversed = false;
+        table = key.empty() ? 0 : key[0];
+        it = newIterator(table);
+        it->Seek(key);
+        SkipForward();
+    }
+    void Next() override {
+        if (Valid()) {
+            it->Next();
+            SkipForward();
+        } else if (reversed) {
+            Seek({});
+        }
+        reversed = false;
+    }
+    void Prev() override {
+        if (Valid()) {
+            it->Prev();
+            SkipBackward();
+        } else if (!reversed) {
+            table = std::numeric_limits<unsigned char>::max();
+            it = newIterator(table);
+            it->Prev();
+            SkipBackward();
+        }
+        reversed = true;
+    }
+    bool Valid() override {
+        return it && it->Valid();
+    }
+    TBytesView Key() override {
+        return it->Key();
+    }
+    TBytesView Value() override {
+        return it->Value();
+    }
+private:
+    void SkipForward() {
+        while (!it->Valid() && table < std::numeric_limits<unsigned char>::max()) {
+            it = newIterator(++table);
+            it->Seek(TBytes{table});
+        }
+    }
+    void SkipBackward() {
+        while (!it->Valid() && table > 0) {
+            it = newIterator(--table);
+            it->Prev(); // fresh iterator steps to the last key
+        }
+    }
+    TableIterator newIterator;
+    std::unique_ptr<CStorageKVIterator> it;
+    unsigned char table = 0;
+    bool reversed = false; // last move was backward
+};
+
+// Read-only point in time state of leveldb storage and write buffers above it,
+// reads don't block and are not affected by writers of the storage
+class CStorageSnapshot : public CStorageKV {
+public:
+    struct Instance {
+        CDBWrapper* db;
+        std::shared_ptr<const leveldb::Snapshot> snapshot;
+    };
+    using Layers = std::vector<std::shared_ptr<const CStorageWriteBuffer>>; // upper first
+
+    CStorageSnapshot(std::vector<Instance> instances, const std::array<size_t, 256>& tables, Layers layers)
+        : instances(std::move(instances)), tables(tables), layers(std::move(layers)) {}
+    CStorageSnapshot(const CStorageSnapshot&) = delete;
+    ~CStorageSnapshot() override = default;
+
+    bool Exists(const TBytes& key) const override {
+        for (const auto& layer : layers) {
+            auto it = layer->find(key);
+            if (it != layer->end()) {
+                return bool(it->second);
+            }
+        }
+        const auto& instance = Route(key);
+        return instance.db->Exists(refTBytes(key), instance.snapshot.get());
+    }
+    bool Read(const TBytes& key, TBytes& value) const override {
+        for (const auto& layer : layers) {
+            auto it = layer->find(key);
+            if (it != layer->end()) {
+                if (it->second) {
+                    value.assign(it->second->begin(), it->second->end());
+                }
+                return bool(it->second);
+            }
+        }
+        const auto& instance = Route(key);
+        auto rawVal = refTBytes(value);
+        return instance.db->Read(refTBytes(key), rawVal, instance.snapshot.get());
+    }
+    // it's immutable, changes are kept by the view above
+    bool Write(const TBytes&, const TBytes&) override {
+        return false;
+    }
+    bool Erase(const TBytes&) override {
+        return false;
+    }
+    bool Flush() override {
+        return false;
+    }
+    void Discard() override {}
+    size_t SizeEstimate() const override {
+        return 0;
+    }
+    using CStorageKV::NewIterator;
+    std::unique_ptr<CStorageKVIterator> NewIterator(const TBytes& prefix) override {
+        std::unique_ptr<CStorageKVIterator> it;
+        if (!prefix.empty() || instances.size() == 1) {
+            it = NewIterator(Route(prefix), prefix);
+        } else {
+            it = MakeUnique<CStorageTablesIterator>([this](unsigned char table) {
+                return NewIterator(instances[tables[table]], TBytes{table});
+            });
+        }
+        for (auto layer = layers.rbegin(); layer != layers.rend(); ++layer) {
+            it = MakeUnique<CFlushableStorageKVIterator>(std::move(it), **layer, prefix);
+        }
+        return it;
+    }
+
+private:
+    const Instance& Route(const TBytes& key) const {
+        return instances[key.empty() ? 0 : tables[key[0]]];
+    }
+    static std::unique_ptr<CStorageKVIterator> NewIterator(const Instance& instance, const TBytes& prefix) {
+        return MakeUnique<CStorageLevelDBIterator>(std::unique_ptr<CDBIterator>(instance.db->NewIterator(instance.snapshot.get())), prefix);
+    }
+
+    const std::vector<Instance> instances;
+    const std::array<size_t, 256> tables;
+    const Layers layers;
+};
+
+// Tables (by key prefix) kept in their own leveldb instance
+struct CStorageTableGroup {
+    std::string name;
+    TBytes prefixes;
+    CDBTuning tuning;
+    int cachePercent; // of the storage cache size
+};
+
+// LevelDB glue layer storage
+// Changes of a flushable layer can be written in background by FlushAsync,
+// they are read from memory until the write is complete. Writes are done one
+// by one by a single worker thread started on the first of them.
+// Table groups are stored in separate instances next to the main one, every instance
+// keeps the flush counter under empty key to detect the write interrupted in between
+class CStorageLevelDB : public CStorageKV {
+public:
+    explicit CStorageLevelDB(const fs::path& dbName, std::size_t cacheSize, bool fMemory = false, bool fWipe = false, std::size_t readCacheSize = 0, const std::vector<CStorageTableGroup>& groups = {})
+        : readCache(readCacheSize) {
+        tables.fill(0);
+        auto mainCacheSize = cacheSize;
+        for (const auto& group : groups) {
+            mainCacheSize -= cacheSize * group.cachePercent / 100;
+        }
+        instances.emplace_back(MakeUnique<Instance>(dbName, mainCacheSize, fMemory, fWipe, CDBTuning{}));
+        for (const auto& group : groups) {
+            for (auto prefix : group.prefixes) {
+                tables[prefix] = instances.size();
+            }
+            instances.emplace_back(MakeUnique<Instance>(GroupPath(dbName, group), cacheSize * group.cachePercent / 100, fMemory, fWipe, group.tuning));
+        }
+        if (instances.size() > 1) {
+            instances[0]->db.Read(refTBytes(SeqKey()), flushSeq);
+        }
+    }
+    ~CStorageLevelDB() override {
+        WaitAsync();
+        if (asyncThread.joinable()) {
+            WITH_LOCK(cs_async, asyncStop = true);
+            asyncCond.notify_all();
+            asyncThread.join();
+        }
+    }
+
+    static fs::path GroupPath(const fs::path& dbName, const CStorageTableGroup& group) {
+        return dbName.parent_path() / (dbName.filename().string() + "_" + group.name);
+    }
+    // false if a flush was interrupted between instances
+    bool IsConsistent() const {
+        if (instances.size() == 1) {
+            return true;
+        }
+        for (const auto& instance : instances) {
+            uint64_t seq = 0;
+            instance->db.Read(refTBytes(SeqKey()), seq);
+            if (seq != flushSeq) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Exists(const TBytes& key) const override {
+        if (auto it = FindAsync(key)) {
+            return bool((*it)->second);
+        }
+        Optional<TBytes> value;
+        if (readCache.Get(key, value)) {
+            return bool(value);
+        }
+        return Route(key).db.Exists(refTBytes(key));
+    }
+    // Written keys are dropped from read cache at once,
+    // it is not filled until the batch is flushed or discarded
+    bool Write(const TBytes& key, const TBytes& value) override {
+        readCache.Drop(key);
+        pending = true;
+        Route(key).batch.Write(refTBytes(key), refTBytes(value));
+        return true;
+    }
+    bool Erase(const TBytes& key) override {
+        readCache.Drop(key);
+        pending = true;
+        CStorageCompactionQueue::AddKey(erased, key);
+        Route(key).batch.Erase(refTBytes(key));
+        return true;
+    }
+    bool Read(const TBytes& key, TBytes& value) const override {
+        if (auto it = FindAsync(key)) {
+            if ((*it)->second) {
+                value.assign((*it)->second->begin(), (*it)->second->end());
+            }
+            return bool((*it)->second);
+        }
+        Optional<TBytes> cached;
+        if (readCache.Get(key, cached)) {
+            if (cached) {
+                value = std::move(*cached);
+            }
+            return bool(cached);
+        }
+        auto rawVal = refTBytes(value);
+        auto result = Route(key).db.Read(refTBytes(key), rawVal);
+        if (!pending) {
+            readCache.Put(key, result ? Optional<TBytes>{value} : Optional<TBytes>{});
+        }
+        return result;
+    }
+    bool Flush() override { // Commit batch
+        // keep the order of writes
+        if (!WaitAsync()) {
+            return false;
+        }
+        auto result = WriteBatches(&Instance::batch);
+        pending = false;
+        // prevent db fragmentation, erased ranges are compacted later
+        if (result) {
+            compactions.Push(erased);
+        }
+        erased.clear();
+        return result;
+    }
+    void Discard() override {
+        erased.clear();
+        for (auto& instance : instances) {
+            instance->batch.Clear();
+        }
+        pending = false;
+    }
+    size_t SizeEstimate() const override {
+        size_t size = async ? async->DynamicUsage() : 0;
+        for (const auto& instance : instances) {
+            size += instance->batch.SizeEstimate();
+        }
+        return size;
+    }
+    using CStorageKV::NewIterator;
+    std::unique_ptr<CStorageKVIterator> NewIterator(const TBytes& prefix) override {
+        std::unique_ptr<CStorageKVIterator> it;
+        if (!prefix.empty() || instances.size() == 1) {
+            it = Route(prefix).NewIterator(prefix);
+        } else {
+            it = MakeUnique<CStorageTablesIterator>([this](unsigned char table) {
+                return instances[tables[table]]->NewIterator(TBytes{table});
+            });
+        }
+        if (async) {
+            return MakeUnique<CFlushableStorageKVIterator>(std::move(it), *async, prefix);
+        }
+        return it;
+    }
+    bool IsEmpty() {
+        if (instances.size() == 1) {
+            return instances[0]->db.IsEmpty();
+        }
+        auto it = NewIterator();
+        it->Seek({});
+        return !it->Valid();
+    }
+    const CStorageReadCache& GetReadCache() const {
+        return readCache;
+    }
+
+    // Read-only state with the write buffer above, pending batch is not seen.
+    // It's reused while the tag is the same and should not outlive the storage
+    std::shared_ptr<CStorageKV> Snapshot(const CStorageWriteBuffer& top, const uint256& tag) {
+        if (snapshot && snapshotTag == tag) {
+            return snapshot;
+        }
+        std::vector<CStorageSnapshot::Instance> dbs;
+        for (auto& instance : instances) {
+            dbs.push_back({&instance->db, instance->db.GetSnapshot()});
+        }
+        CStorageSnapshot::Layers layers{top.Clone()};
+        if (async) {
+            layers.push_back(async);
+        }
+        snapshot = std::make_shared<CStorageSnapshot>(std::move(dbs), tables, std::move(layers));
+        snapshotTag = tag;
+        return snapshot;
+    }
+
+    // Writes the changes in background thread, the result of previous write is returned.
+    // Iterators created before are invalidated
+    bool FlushAsync(std::unique_ptr<CStorageWriteBuffer> changes) {
+        // pending batch is older than the changes
+        auto result = Flush();
+        async = std::move(changes);
+        if (!asyncThread.joinable()) {
+            asyncThread = std::thread(&TraceThread<std::function<void()>>, "flushasync", [this] {
+                AsyncWorker();
+            });
+        }
+        WITH_LOCK(cs_async, asyncQueued = true);
+        asyncCond.notify_all();
+        return result;
+    }
+    // waits background write if any, returns its result
+    bool WaitAsync() {
+        WAIT_LOCK(cs_async, lock);
+        while (asyncQueued) {
+            asyncCond.wait(lock);
+        }
+        async.reset();
+        auto result = asyncResult;
+        asyncResult = true;
+        return result;
+    }
+    // Compacts up to count of erased ranges, called by scheduler to not block the flush
+    size_t Compact(size_t count) {
+        size_t compacted = 0;
+        CStorageCompactionQueue::Range range;
+        while (compacted < count && compactions.Pop(range)) {
+            auto start = GetTimeMicros();
+            Route(range.first).db.CompactRange(refTBytes(range.first), refTBytes(range.second));
+            compactions.Done(GetTimeMicros() - start);
+            ++compacted;
+        }
+        return compacted;
+    }
+    CStorageCompactionQueue::Stats GetCompactionStats() const {
+        return compactions.GetStats();
+    }
+
+private:
+    struct Instance {
+        CDBWrapper db;
+        CDBBatch batch;
+        CDBBatch asyncBatch;
+
+        Instance(const fs::path& path, size_t cacheSize, bool fMemory, bool fWipe, const CDBTuning& tuning)
+            : db{path, cacheSize, fMemory, fWipe, false, tuning}, batch(db), asyncBatch(db) {}
+
+        std::unique_ptr<CStorageKVIterator> NewIterator(const TBytes& prefix) {
+            return MakeUnique<CStorageLevelDBIterator>(std::unique_ptr<CDBIterator>(db.NewIterator()), prefix);
+        }
+    };
+
+    // no table key is empty
+    static const TBytes& SeqKey() {
+        static const TBytes key;
+        return key;
+    }
+    Instance& Route(const TBytes& key) const {
+        return *instances[key.empty() ? 0 : tables[key[0]]];
+    }
+    // batches of all instances are written with the next flush counter
+    bool WriteBatches(CDBBatch Instance::*batch) {
+        auto result = true;
+        if (instances.size() > 1) {
+            ++flushSeq;
+        }
+        for (auto& instance : instances) {
+            if (instances.size() > 1) {
+                ((*instance).*batch).Write(refTBytes(SeqKey()), flushSeq);
+            }
+            result = instance->db.WriteBatch((*instance).*batch) && result;
+            ((*instance).*batch).Clear();
+        }
+        return result;
+    }
+    Optional<CStorageWriteBuffer::const_iterator> FindAsync(const TBytes& key) const {
+        if (async) {
+            auto it = async->find(key);
+            if (it != async->end()) {
+                return it;
+            }
+        }
+        return {};
+    }
+    void AsyncWorker() {
+        while (true) {
+            {
+                WAIT_LOCK(cs_async, lock);
+                while (!asyncQueued && !asyncStop) {
+                    asyncCond.wait(lock);
+                }
+                if (!asyncQueued) {
+                    return;
+                }
+            }
+            auto result = WriteAsync();
+            {
+                LOCK(cs_async);
+                asyncResult = result;
+                asyncQueued = false;
+            }
+            asyncCond.notify_all();
+        }
+    }
+    bool WriteAsync() {
+        TBytes key, value;
+        CStorageCompactionQueue::Ranges asyncErased;
+        for (const auto& it : *async) {
+            key.assign(it.first.begin(), it.first.end());
+            // cached value is overwritten
+            readCache.Drop(key);
+            if (!it.second) {
+                CStorageCompactionQueue::AddKey(asyncErased, key);
+                Route(key).asyncBatch.Erase(refTBytes(key));
+                continue;
+            }
+            value.assign(it.second->begin(), it.second->end());
+            Route(key).asyncBatch.Write(refTBytes(key), refTBytes(value));
+        }
+        auto result = WriteBatches(&Instance::asyncBatch);
+        if (result) {
+            compactions.Push(asyncErased);
+        }
+        return result;
+    }
+
+    CStorageCompactionQueue::Ranges erased; // by pending batch
+    CStorageCompactionQueue compactions;
+    std::vector<std::unique_ptr<Instance>> instances; // main one goes first
+    std::array<size_t, 256> tables; // instance by table prefix
+    std::shared_ptr<CStorageKV> snapshot; // goes before instances on destruction
+    uint256 snapshotTag;
+    uint64_t flushSeq = 0;
+    bool pending = false; // batch has changes
+    mutable CStorageReadCache readCache;
+    // changes written in background, they are read only until the write is done
+    std::shared_ptr<const CStorageWriteBuffer> async; // snapshots can hold it
+    std::thread asyncThread;
+    Mutex cs_async;
+    std::condition_variable asyncCond;
+    bool asyncQueued GUARDED_BY(cs_async) = false; // the worker writes async changes
+    bool asyncStop GUARDED_BY(cs_async) = false;
+    bool asyncResult GUARDED_BY(cs_async) = true;
+};
+
 // Flushable Key-Value Storage
 class CFlushableStorageKV : public CStorageKV {
 public:
-    explicit CFlushableStorageKV(CStorageKV& db_) : db(db_) {}
+    explicit CFlushableStorageKV(CStorageKV& db_) : db(db_), changed(MakeUnique<CStorageWriteBuffer>()) {}
     CFlushableStorageKV(const CFlushableStorageKV&) = delete;
     ~CFlushableStorageKV() override = default;
 
     bool Exists(const TBytes& key) const override {
-        auto it = changed.find(key);
-        if (it != changed.end()) {
+        auto it = changed->find(key);
+        if (it != changed->end()) {
             return bool(it->second);
         }
         return db.Exists(key);
     }
     bool Write(const TBytes& key, const TBytes& value) override {
-        changed[key] = value;
+        changed->Write(key, value);
         return true;
     }
     bool Erase(const TBytes& key) override {
-        changed[key] = {};
+        changed->Erase(key);
         return true;
     }
     bool Read(const TBytes& key, TBytes& value) const override {
-        auto it = changed.find(key);
-        if (it == changed.end()) {
+        auto it = changed->find(key);
+        if (it == changed->end()) {
             return db.Read(key, value);
         } else if (it->second) {
-            value = it->second.get();
+            value.assign(it->second->begin(), it->second->end());
             return true;
         } else {
             return false;
         }
     }
     bool Flush() override {
-        for (const auto& it : changed) {
+        TBytes key, value;
+        for (const auto& it : *changed) {
+            key.assign(it.first.begin(), it.first.end());
             if (!it.second) {
-                if (!db.Erase(it.first)) {
+                if (!db.Erase(key)) {
                     return false;
                 }
-            } else if (!db.Write(it.first, it.second.get())) {
+                continue;
+            }
+            value.assign(it.second->begin(), it.second->end());
+            if (!db.Write(key, value)) {
                 return false;
             }
         }
-        changed.clear();
+        changed->Clear();
         return true;
     }
     void Discard() override {
-        changed.clear();
+        changed->Clear();
     }
     size_t SizeEstimate() const override {
-        return memusage::DynamicUsage(changed);
+        return changed->DynamicUsage();
     }
-    std::unique_ptr<CStorageKVIterator> NewIterator() override {
-        return MakeUnique<CFlushableStorageKVIterator>(db.NewIterator(), changed);
+    using CStorageKV::NewIterator;
+    std::unique_ptr<CStorageKVIterator> NewIterator(const TBytes& prefix) override {
+        return MakeUnique<CFlushableStorageKVIterator>(db.NewIterator(prefix), *changed, prefix);
     }
 
-    MapKV& GetRaw() {
-        return changed;
+    CStorageWriteBuffer& GetRaw() {
+        return *changed;
+    }
+    // takes the changes away to be written elsewhere, iterators of the layer are invalidated
+    std::unique_ptr<CStorageWriteBuffer> Detach() {
+        auto result = std::move(changed);
+        changed = MakeUnique<CStorageWriteBuffer>();
+        return result;
     }
 
 private:
     CStorageKV& db;
-    MapKV changed;
+    std::unique_ptr<CStorageWriteBuffer> changed;
 };
 
 template<typename T>
@@ -357,7 +1406,13 @@ class CStorageIteratorWrapper {
     std::unique_ptr<CStorageKVIterator> it;
 
     void UpdateValidity() {
-        valid = it->Valid() && BytesToDbType(it->Key(), key) && key.first == By::prefix;
+        if (!it->Valid()) {
+            valid = false;
+            return;
+        }
+        // cheap check of the table prefix before decoding whole key
+        auto rawKey = it->Key();
+        valid = rawKey.size() > 0 && rawKey[0] == By::prefix && BytesToDbType(rawKey, key) && key.first == By::prefix;
     }
 
     struct Resolver {
@@ -471,7 +1526,7 @@ public:
     }
     template<typename By, typename KeyType>
     CStorageIteratorWrapper<By, KeyType> LowerBound(KeyType const & key) {
-        CStorageIteratorWrapper<By, KeyType> it{DB().NewIterator()};
+        CStorageIteratorWrapper<By, KeyType> it{DB().NewIterator(TBytes{By::prefix})};
         it.Seek(key);
         return it;
     }
@@ -485,6 +1540,17 @@ public:
             }
         }
     }
+    // keys only scan, values are never read
+    template<typename By, typename KeyType>
+    void ForEachKey(std::function<bool(KeyType const &)> callback, KeyType const & start = {}) {
+        for(auto it = LowerBound<By>(start); it.Valid(); it.Next()) {
+            boost::this_thread::interruption_point();
+
+            if (!callback(it.Key())) {
+                break;
+            }
+        }
+    }
 
     bool Flush() { return DB().Flush(); }
     void Discard() { DB().Discard(); }
@@ -29,6 +29,8 @@
 #include <masternodes/anchors.h>
 #include <masternodes/criminals.h>
 #include <masternodes/masternodes.h>
+#include <masternodes/poolhistory.h>
+#include <masternodes/poolproviders.h>
 #include <miner.h>
 #include <net.h>
 #include <net_permissions.h>
@@ -277,6 +279,8 @@ void Shutdown(InitInterfaces& interfaces)
         panchors.reset();
         panchorAwaitingConfirms.reset();
         panchorauths.reset();
+        ppoolProviders.reset();
+        ResetPoolSwapGraph();
         pcustomcsview.reset();
         pcustomcsDB.reset();
         pcriminals.reset();
@@ -395,6 +399,9 @@ void SetupServerArgs()
     gArgs.AddArg("-conf=<file>", strprintf("Specify configuration file. Relative paths will be prefixed by datadir location. (default: %s)", DEFI_CONF_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-datadir=<dir>", "Specify data directory", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-customasyncflush", strprintf("Write enhanced chainstate to disk in background while next blocks are connected (default: %u)", DEFAULT_CUSTOM_ASYNC_FLUSH), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-customtables=<group>", "Store group of enhanced chainstate tables in separate database with own tuning, changing it requires -reindex-chainstate. Can be specified multiple times. Groups: undo, balances, pools", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-customcache=<n>", strprintf("Maximum enhanced chainstate read cache size <n> MiB (0 to %d, default: %d). It is allocated in addition to -dbcache", nMaxCustomCache, nDefaultCustomCache), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool).", nMinDbCache, nMaxDbCache, nDefaultDbCache), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (-nodebuglogfile to disable; default: %s)", DEFAULT_DEBUGLOGFILE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
@@ -420,6 +427,8 @@ void SetupServerArgs()
 #endif
     gArgs.AddArg("-txindex", strprintf("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)", DEFAULT_TXINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-acindex", strprintf("Maintain a full account history index, tracking all accounts balances changes. Used by the listaccounthistory and accounthistorycount rpc calls (default: %u)", false), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-acindexsecondary", strprintf("Maintain indexes of account history by txid, token and transaction type. Used by filtered listaccounthistory and accounthistorycount rpc calls, it should be set before the account history is built (default: %u)", DEFAULT_ACINDEX_SECONDARY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-poolhistoryindex", strprintf("Maintain an index of pools reserves, liquidity and swap volumes per block. Used by the getpoolhistory rpc call (default: %u)", DEFAULT_POOLHISTORYINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blockfilterindex=<type>",
                  strprintf("Maintain an index of compact filters by block (default: %s, values: %s).", DEFAULT_BLOCKFILTERINDEX, ListBlockFilterTypes()) +
                  " If <type> is not supplied or if <type> = 1, indexes for all known types are enabled.",
@@ -528,6 +537,7 @@ void SetupServerArgs()
     gArgs.AddArg("-checkblockindex", strprintf("Do a full consistency check for the block tree, setBlockIndexCandidates, ::ChainActive() and mapBlocksUnlinked occasionally. (default: %u, regtest: %u)", defaultChainParams->DefaultConsistencyChecks(), regtestChainParams->DefaultConsistencyChecks()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u, regtest: %u)", defaultChainParams->DefaultConsistencyChecks(), regtestChainParams->DefaultConsistencyChecks()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-customcompactinterval=<n>", strprintf("Compact erased key ranges of enhanced chainstate in background, one table every <n> seconds (default: %d)", nDefaultCustomCompactInterval), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-deprecatedrpc=<method>", "Allows deprecated RPC method(s) to be used", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-dropmessagestest=<n>", "Randomly drop 1 of every <n> network messages", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-stopafterblockimport", strprintf("Stop running after importing blocks from disk (default: %u)", DEFAULT_STOPAFTERBLOCKIMPORT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
@@ -1073,6 +1083,7 @@ bool AppInitParameterInteraction()
     }
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fCustomAsyncFlush = gArgs.GetBoolArg("-customasyncflush", DEFAULT_CUSTOM_ASYNC_FLUSH);
 
     hashAssumeValid = uint256S(gArgs.GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
     if (!hashAssumeValid.IsNull())
@@ -1496,6 +1507,9 @@ bool AppInitMain(InitInterfaces& interfaces)
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
     nCustomMemUsage = std::max((nTotalCache >> 8), (nMinDbCache << 16)); // use significant less in-memory cache
+    int64_t nCustomReadCache = gArgs.GetArg("-customcache", nDefaultCustomCache) << 20;
+    nCustomReadCache = std::max(nCustomReadCache, int64_t(0));
+    nCustomReadCache = std::min(nCustomReadCache, nMaxCustomCache << 20);
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1f MiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
@@ -1508,6 +1522,7 @@ bool AppInitMain(InitInterfaces& interfaces)
     }
     LogPrintf("* Using %.1f MiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1f MiB for in-memory UTXO set (plus up to %.1f MiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1f MiB for enhanced chainstate read cache\n", nCustomReadCache * (1.0 / 1024 / 1024));
 
     bool fLoaded = false;
     while (!fLoaded && !ShutdownRequested()) {
@@ -1589,8 +1604,38 @@ bool AppInitMain(InitInterfaces& interfaces)
                 pcriminals.reset();
                 pcriminals = MakeUnique<CCriminalsView>(GetDataDir() / "criminals", nCustomCacheSize, false, fReset || fReindexChainState);
 
+                // table groups can't be moved between instances without rebuild
+                std::vector<CStorageTableGroup> customTableGroups;
+                const auto customTables = gArgs.GetArgs("-customtables");
+                const auto customDbPath = GetDataDir() / "enhancedcs";
+                for (const auto& group : CCustomCSView::TableGroups()) {
+                    auto groupPath = CStorageLevelDB::GroupPath(customDbPath, group);
+                    auto enabled = std::find(customTables.begin(), customTables.end(), group.name) != customTables.end();
+                    if (fReset || fReindexChainState) {
+                        if (!enabled) {
+                            fs::remove_all(groupPath);
+                        }
+                    } else if (enabled ? !fs::exists(groupPath) && fs::exists(customDbPath) : fs::exists(groupPath)) {
+                        strLoadError = strprintf(_("Enhanced chainstate tables layout is changed (%s). You will need to rebuild the database using -reindex-chainstate.").translated, group.name);
+                        break;
+                    }
+                    if (enabled) {
+                        customTableGroups.push_back(group);
+                    }
+                }
+                if (strLoadError.empty() && customTableGroups.size() != customTables.size()) {
+                    strLoadError = _("Invalid -customtables group").translated;
+                }
+                if (!strLoadError.empty()) {
+                    break;
+                }
+
                 pcustomcsDB.reset();
-                pcustomcsDB = MakeUnique<CStorageLevelDB>(GetDataDir() / "enhancedcs", nCustomCacheSize, false, fReset || fReindexChainState);
+                pcustomcsDB = MakeUnique<CStorageLevelDB>(customDbPath, nCustomCacheSize, false, fReset || fReindexChainState, nCustomReadCache, customTableGroups);
+                if (!pcustomcsDB->IsConsistent()) {
+                    strLoadError = _("Enhanced chainstate flush was interrupted. You will need to rebuild the database using -reindex-chainstate.").translated;
+                    break;
+                }
                 pcustomcsview.reset();
                 pcustomcsview = MakeUnique<CCustomCSView>(*pcustomcsDB.get());
                 if (!fReset && !fReindexChainState) {
@@ -1603,15 +1648,25 @@ bool AppInitMain(InitInterfaces& interfaces)
                 // Ensure we are on latest DB version
                 pcustomcsview->SetDbVersion(CCustomCSView::DbVersion);
 
+                // Pool shares written before the owner index are indexed once
+                if (pcustomcsview->BuildOwnerShareIndex()) {
+                    LogPrintf("Pool shares are indexed by owner\n");
+                }
+
                 // make account history db
                 paccountHistoryDB.reset();
                 if (gArgs.GetBoolArg("-acindex", DEFAULT_ACINDEX)) {
-                    paccountHistoryDB = MakeUnique<CAccountHistoryStorage>(GetDataDir() / "history", nCustomCacheSize, false, fReset || fReindexChainState);
+                    paccountHistoryDB = MakeUnique<CAccountHistoryStorage>(GetDataDir() / "history", nCustomCacheSize, false, fReset || fReindexChainState, gArgs.GetBoolArg("-acindexsecondary", DEFAULT_ACINDEX_SECONDARY));
                 }
 
                 pburnHistoryDB.reset();
                 pburnHistoryDB = MakeUnique<CBurnHistoryStorage>(GetDataDir() / "burn", nCustomCacheSize, false, fReset || fReindexChainState);
 
+                ppoolHistoryDB.reset();
+                if (gArgs.GetBoolArg("-poolhistoryindex", DEFAULT_POOLHISTORYINDEX)) {
+                    ppoolHistoryDB = MakeUnique<CPoolHistoryStorage>(GetDataDir() / "poolhistory", nCustomCacheSize, false, fReset || fReindexChainState);
+                }
+
                 // If necessary, upgrade from older database format.
                 // This is a no-op if we cleared the coinsviewdb with -reindex or -reindex-chainstate
                 if (!::ChainstateActive().CoinsDB().Upgrade()) {
@@ -1625,6 +1680,20 @@ bool AppInitMain(InitInterfaces& interfaces)
                     break;
                 }
 
+                // Background flush of enhanced chainstate could be interrupted, check it matches the coins tip
+                if (!fReset && !fReindexChainState) {
+                    auto flushEpoch = pcustomcsview->GetFlushEpoch();
+                    auto bestBlock = ::ChainstateActive().CoinsDB().GetBestBlock();
+                    if (flushEpoch && !bestBlock.IsNull() && flushEpoch->blockHash != bestBlock) {
+                        strLoadError = _("Enhanced chainstate is not flushed at the chain tip. You will need to rebuild the database using -reindex-chainstate.").translated;
+                        break;
+                    }
+                }
+
+                // providers registry isn't stored, it's built from pool shares of the tip and follows it
+                ppoolProviders = MakeUnique<CPoolProvidersRegistry>();
+                ppoolProviders->Load(*pcustomcsview);
+
                 // The on-disk coinsdb is now in a good state, create the cache
                 ::ChainstateActive().InitCoinsCache();
                 assert(::ChainstateActive().CanFlushToDisk());
@@ -1931,6 +2000,13 @@ bool AppInitMain(InitInterfaces& interfaces)
         g_banman->DumpBanlist();
     }, DUMP_BANS_INTERVAL * 1000);
 
+    // rate limited compaction of enhanced chainstate, flush doesn't wait for it
+    scheduler.scheduleEvery([]{
+        if (pcustomcsDB) {
+            pcustomcsDB->Compact(1);
+        }
+    }, std::max<int64_t>(gArgs.GetArg("-customcompactinterval", nDefaultCustomCompactInterval), 1) * 1000);
+
     // ********************************************************* Step XX: start spv
     if (spv::pspv)
     {
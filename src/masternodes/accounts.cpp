@@ -85,9 +85,7 @@ Res CAccountsView::SubBalances(CScript const & owner, CBalances const & balances
 
 void CAccountsView::ForEachAccount(std::function<bool(CScript const &)> callback, CScript const & start)
 {
-    ForEach<ByHeightKey, CScript, uint32_t>([&callback] (CScript const & owner, CLazySerialize<uint32_t>) {
-        return callback(owner);
-    }, start);
+    ForEachKey<ByHeightKey>(callback, start);
 }
 
 Res CAccountsView::UpdateBalancesHeight(CScript const & owner, uint32_t height)
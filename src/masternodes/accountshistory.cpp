@@ -9,8 +9,22 @@
 
 /// @Note it's in own database
 const unsigned char CAccountsHistoryView::ByAccountHistoryKey::prefix = 'h';
+const unsigned char CAccountsHistoryView::ByRewardHistoryKey::prefix = 'r';
+const unsigned char CAccountsHistoryView::ByRewardHistoryHeight::prefix = 'R';
+const unsigned char CAccountsHistoryView::ByAccountHistoryTxid::prefix = 'x';
+const unsigned char CAccountsHistoryView::ByAccountHistoryToken::prefix = 'k';
+const unsigned char CAccountsHistoryView::ByAccountHistoryCategory::prefix = 'c';
+const unsigned char CAccountsHistoryView::ByAccountHistoryCount::prefix = 'n';
+const unsigned char CAccountsHistoryView::ByBurnStats::prefix = 'b';
+const unsigned char CAccountsHistoryView::ByHistoryFeatures::prefix = 'i';
 
-void CAccountsHistoryView::ForEachAccountHistory(std::function<bool(AccountHistoryKey const &, CLazySerialize<AccountHistoryValue>)> callback, AccountHistoryKey const & start)
+// keys of ByHistoryFeatures, a feature is enabled if it's maintained since empty database
+static const unsigned char FeatureSecondaryIndexes = 'i';
+static const unsigned char FeatureHistoryCounts = 'n';
+static const unsigned char FeatureBurnStats = 'b';
+static const unsigned char FeatureRewardHistory = 'r';
+
+void CAccountsHistoryView::ForEachAccountHistory(AccountHistoryCallback callback, AccountHistoryKey const & start)
 {
     ForEach<ByAccountHistoryKey, AccountHistoryKey, AccountHistoryValue>(callback, start);
 }
@@ -18,23 +32,320 @@ void CAccountsHistoryView::ForEachAccountHistory(std::function<bool(AccountHisto
 Res CAccountsHistoryView::WriteAccountHistory(const AccountHistoryKey& key, const AccountHistoryValue& value)
 {
     WriteBy<ByAccountHistoryKey>(key, value);
+    if (secondaryIndexes) {
+        WriteBy<ByAccountHistoryTxid>(AccountHistoryIndexKey<uint256>{value.txid, key}, '\0');
+        WriteBy<ByAccountHistoryCategory>(AccountHistoryIndexKey<uint8_t>{value.category, key}, '\0');
+        for (const auto& diff : value.diff) {
+            WriteBy<ByAccountHistoryToken>(AccountHistoryIndexKey<DCT_ID>{diff.first, key}, '\0');
+        }
+    }
+    if (historyCounts) {
+        UpdateHistoryCounts(key, value, 1);
+    }
+    if (burnStats) {
+        UpdateBurnStats(key, value, 1);
+    }
     return Res::Ok();
 }
 
 Res CAccountsHistoryView::EraseAccountHistory(const AccountHistoryKey& key)
 {
+    AccountHistoryValue value;
+    if ((secondaryIndexes || historyCounts || burnStats) && ReadBy<ByAccountHistoryKey>(key, value)) {
+        if (secondaryIndexes) {
+            EraseBy<ByAccountHistoryTxid>(AccountHistoryIndexKey<uint256>{value.txid, key});
+            EraseBy<ByAccountHistoryCategory>(AccountHistoryIndexKey<uint8_t>{value.category, key});
+            for (const auto& diff : value.diff) {
+                EraseBy<ByAccountHistoryToken>(AccountHistoryIndexKey<DCT_ID>{diff.first, key});
+            }
+        }
+        if (historyCounts) {
+            UpdateHistoryCounts(key, value, -1);
+        }
+        if (burnStats) {
+            UpdateBurnStats(key, value, -1);
+        }
+    }
     EraseBy<ByAccountHistoryKey>(key);
     return Res::Ok();
 }
 
-CAccountHistoryStorage::CAccountHistoryStorage(const fs::path& dbName, std::size_t cacheSize, bool fMemory, bool fWipe)
+bool CAccountsHistoryView::HasSecondaryIndexes() const
+{
+    return secondaryIndexes;
+}
+
+void CAccountsHistoryView::EnableSecondaryIndexes()
+{
+    if (!ExistsBy<ByHistoryFeatures>(FeatureSecondaryIndexes)) {
+        // existing records aren't indexed
+        if (LowerBound<ByAccountHistoryKey>(AccountHistoryKey{}).Valid()) {
+            LogPrintf("Account history secondary indexes need -reindex-chainstate to be built\n");
+            return;
+        }
+        WriteBy<ByHistoryFeatures>(FeatureSecondaryIndexes, '\0');
+    }
+    secondaryIndexes = true;
+}
+
+bool CAccountsHistoryView::HasHistoryCounts() const
+{
+    return historyCounts;
+}
+
+void CAccountsHistoryView::EnableHistoryCounts()
+{
+    if (!ExistsBy<ByHistoryFeatures>(FeatureHistoryCounts)) {
+        // existing records aren't counted
+        if (LowerBound<ByAccountHistoryKey>(AccountHistoryKey{}).Valid()) {
+            LogPrintf("Account history counters need -reindex-chainstate to be built\n");
+            return;
+        }
+        WriteBy<ByHistoryFeatures>(FeatureHistoryCounts, '\0');
+    }
+    historyCounts = true;
+}
+
+void CAccountsHistoryView::UpdateHistoryCounts(AccountHistoryKey const & key, AccountHistoryValue const & value, int64_t change)
+{
+    const DCT_ID anyToken{AccountHistoryCountKey::AnyToken};
+    for (const auto& owner : {key.owner, CScript{}}) {
+        countChanges[{owner, 0, anyToken}] += change;
+        if (value.category != 0) {
+            countChanges[{owner, value.category, anyToken}] += change;
+        }
+        for (const auto& diff : value.diff) {
+            countChanges[{owner, 0, diff.first}] += change;
+            if (value.category != 0) {
+                countChanges[{owner, value.category, diff.first}] += change;
+            }
+        }
+    }
+}
+
+bool CAccountsHistoryView::HasBurnStats() const
+{
+    return burnStats;
+}
+
+void CAccountsHistoryView::EnableBurnStats()
+{
+    if (!ExistsBy<ByHistoryFeatures>(FeatureBurnStats)) {
+        // existing records aren't summed
+        if (LowerBound<ByAccountHistoryKey>(AccountHistoryKey{}).Valid()) {
+            LogPrintf("Burn history statistics need -reindex-chainstate to be built\n");
+            return;
+        }
+        WriteBy<ByHistoryFeatures>(FeatureBurnStats, '\0');
+    }
+    burnStats = true;
+}
+
+void CAccountsHistoryView::UpdateBurnStats(AccountHistoryKey const & key, AccountHistoryValue const & value, int64_t sign)
+{
+    for (const auto range : {key.blockHeight / BurnStatsInterval, BurnStatsKey::AllHeights}) {
+        auto& amounts = burnChanges[{range, value.category}];
+        for (const auto& diff : value.diff) {
+            amounts[diff.first] += sign * diff.second;
+        }
+    }
+}
+
+std::map<uint8_t, TAmounts> CAccountsHistoryView::GetBurnStats(boost::optional<uint32_t> height)
+{
+    std::map<uint8_t, TAmounts> stats;
+    auto addAmounts = [&stats](uint8_t category, TAmounts const & amounts) {
+        for (const auto& amount : amounts) {
+            stats[category][amount.first] += amount.second;
+        }
+    };
+    // totals, or sums of whole ranges below the height
+    auto it = LowerBound<ByBurnStats>(BurnStatsKey{height ? 0 : BurnStatsKey::AllHeights, 0});
+    for (; it.Valid() && (!height || it.Key().range < *height / BurnStatsInterval); it.Next()) {
+        addAmounts(it.Key().category, it.Value().as<TAmounts>());
+    }
+    if (!height) {
+        return stats;
+    }
+    // records of the range of the height, owner by owner
+    const auto rangeBegin = *height / BurnStatsInterval * BurnStatsInterval;
+    auto history = LowerBound<ByAccountHistoryKey>(AccountHistoryKey{});
+    while (history.Valid()) {
+        const auto owner = history.Key().owner;
+        history.Seek(AccountHistoryKey{owner, *height, std::numeric_limits<uint32_t>::max()});
+        for (; history.Valid() && history.Key().owner == owner && history.Key().blockHeight >= rangeBegin; history.Next()) {
+            const auto value = history.Value().as<AccountHistoryValue>();
+            addAmounts(value.category, value.diff);
+        }
+        history.Seek(AccountHistoryKey{owner, 0, 0}); // the last possible key of the owner
+        if (history.Valid() && history.Key().owner == owner) {
+            history.Next();
+        }
+    }
+    return stats;
+}
+
+uint64_t CAccountsHistoryView::GetAccountHistoryCount(CScript const & owner, uint8_t category, boost::optional<DCT_ID> token) const
+{
+    uint64_t count = 0;
+    ReadBy<ByAccountHistoryCount>(AccountHistoryCountKey{owner, category, token.value_or(DCT_ID{AccountHistoryCountKey::AnyToken})}, count);
+    return count;
+}
+
+bool CAccountsHistoryView::Flush()
+{
+    for (const auto& change : countChanges) {
+        if (change.second == 0) {
+            continue;
+        }
+        uint64_t count = 0;
+        ReadBy<ByAccountHistoryCount>(change.first, count);
+        count += change.second;
+        if (count == 0) {
+            EraseBy<ByAccountHistoryCount>(change.first);
+        } else {
+            WriteBy<ByAccountHistoryCount>(change.first, count);
+        }
+    }
+    countChanges.clear();
+    for (const auto& change : burnChanges) {
+        TAmounts amounts;
+        ReadBy<ByBurnStats>(change.first, amounts);
+        for (const auto& diff : change.second) {
+            if ((amounts[diff.first] += diff.second) == 0) {
+                amounts.erase(diff.first);
+            }
+        }
+        if (amounts.empty()) {
+            EraseBy<ByBurnStats>(change.first);
+        } else {
+            WriteBy<ByBurnStats>(change.first, amounts);
+        }
+    }
+    burnChanges.clear();
+    return CStorageView::Flush();
+}
+
+void CAccountsHistoryView::Discard()
+{
+    countChanges.clear();
+    burnChanges.clear();
+    CStorageView::Discard();
+}
+
+template<typename By, typename T>
+void CAccountsHistoryView::ForEachIndexedHistory(T const & field, AccountHistoryCallback callback, AccountHistoryKey const & start)
+{
+    // records are read by seeks of the same iterator
+    auto history = LowerBound<ByAccountHistoryKey>(start);
+    for (auto it = LowerBound<By>(AccountHistoryIndexKey<T>{field, start}); it.Valid() && it.Key().field == field; it.Next()) {
+        const auto& key = it.Key().key;
+        history.Seek(key);
+        if (!history.Valid() || history.Key().owner != key.owner || history.Key().blockHeight != key.blockHeight || history.Key().txn != key.txn) {
+            continue;
+        }
+        if (!callback(history.Key(), history.Value())) {
+            break;
+        }
+    }
+}
+
+void CAccountsHistoryView::ForEachAccountHistoryByTxid(uint256 const & txid, AccountHistoryCallback callback, AccountHistoryKey const & start)
+{
+    ForEachIndexedHistory<ByAccountHistoryTxid>(txid, callback, start);
+}
+
+void CAccountsHistoryView::ForEachAccountHistoryByToken(DCT_ID const & tokenId, AccountHistoryCallback callback, AccountHistoryKey const & start)
+{
+    ForEachIndexedHistory<ByAccountHistoryToken>(tokenId, callback, start);
+}
+
+void CAccountsHistoryView::ForEachAccountHistoryByCategory(uint8_t category, AccountHistoryCallback callback, AccountHistoryKey const & start)
+{
+    ForEachIndexedHistory<ByAccountHistoryCategory>(category, callback, start);
+}
+
+bool CAccountsHistoryView::HasRewardHistory() const
+{
+    return rewardHistory;
+}
+
+void CAccountsHistoryView::EnableRewardHistory()
+{
+    if (!ExistsBy<ByHistoryFeatures>(FeatureRewardHistory)) {
+        // rewards settled before aren't recorded
+        if (LowerBound<ByAccountHistoryKey>(AccountHistoryKey{}).Valid()) {
+            LogPrintf("Owner rewards history needs -reindex-chainstate to be recorded\n");
+            return;
+        }
+        WriteBy<ByHistoryFeatures>(FeatureRewardHistory, '\0');
+    }
+    rewardHistory = true;
+}
+
+void CAccountsHistoryView::WriteRewardHistory(RewardHistoryKey const & key, RewardHistoryValue const & value, uint32_t blockHeight)
+{
+    WriteBy<ByRewardHistoryKey>(key, value);
+    WriteBy<ByRewardHistoryHeight>(RewardHistoryHeightKey{blockHeight, key}, '\0');
+}
+
+void CAccountsHistoryView::EraseRewardHistory(uint32_t blockHeight)
+{
+    std::vector<RewardHistoryHeightKey> keys;
+    for (auto it = LowerBound<ByRewardHistoryHeight>(RewardHistoryHeightKey{blockHeight, {}}); it.Valid() && it.Key().blockHeight == blockHeight; it.Next()) {
+        keys.push_back(it.Key());
+    }
+    for (const auto& key : keys) {
+        EraseBy<ByRewardHistoryKey>(key.key);
+        EraseBy<ByRewardHistoryHeight>(key);
+    }
+}
+
+void CAccountsHistoryView::ForEachRewardHistory(CScript const & owner, std::function<bool(uint32_t, DCT_ID const &, CLazySerialize<RewardHistoryValue>)> callback, uint32_t endHeight)
+{
+    ForEach<ByRewardHistoryKey, RewardHistoryKey, RewardHistoryValue>([&](RewardHistoryKey const & key, CLazySerialize<RewardHistoryValue> value) {
+        return key.owner == owner && callback(key.endHeight, key.poolID, value);
+    }, RewardHistoryKey{owner, endHeight, DCT_ID{0}});
+}
+
+void CRewardsHistoryCollector::Add(CScript const & owner, DCT_ID const & poolId, RewardType type, CTokenAmount amount, uint32_t begin, uint32_t end)
+{
+    // rewards are reported pool by pool in height order
+    if (rewards.empty() || rewards.back().first.owner != owner || rewards.back().first.poolID != poolId) {
+        rewards.emplace_back(RewardHistoryKey{owner, end, poolId}, RewardHistoryValue{});
+    }
+    auto& reward = rewards.back();
+    reward.first.endHeight = std::max(reward.first.endHeight, end);
+    reward.second.push_back({begin, end, uint8_t(type), amount});
+}
+
+void CRewardsHistoryCollector::Write(CAccountsHistoryView & historyView, uint32_t blockHeight)
+{
+    for (const auto& reward : rewards) {
+        historyView.WriteRewardHistory(reward.first, reward.second, blockHeight);
+    }
+    rewards.clear();
+}
+
+CAccountHistoryStorage::CAccountHistoryStorage(const fs::path& dbName, std::size_t cacheSize, bool fMemory, bool fWipe, bool fSecondaryIndexes)
     : CStorageView(new CStorageLevelDB(dbName, cacheSize, fMemory, fWipe))
 {
+    if (fSecondaryIndexes) {
+        EnableSecondaryIndexes();
+    } else {
+        // indexes become outdated by writes without them
+        EraseBy<ByHistoryFeatures>(FeatureSecondaryIndexes);
+    }
+    EnableHistoryCounts();
+    EnableRewardHistory();
+    Flush();
 }
 
 CBurnHistoryStorage::CBurnHistoryStorage(const fs::path& dbName, std::size_t cacheSize, bool fMemory, bool fWipe)
     : CStorageView(new CStorageLevelDB(dbName, cacheSize, fMemory, fWipe))
 {
+    EnableBurnStats();
+    Flush();
 }
 
 CAccountsHistoryWriter::CAccountsHistoryWriter(CCustomCSView & storage, uint32_t height, uint32_t txn, const uint256& txid, uint8_t type, CAccountsHistoryView* historyView, CAccountsHistoryView* burnView)
@@ -62,6 +373,18 @@ Res CAccountsHistoryWriter::AddFeeBurn(CScript const & owner, CAmount amount)
     return Res::Ok();
 }
 
+bool CAccountsHistoryWriter::IsRecordingRewards() const
+{
+    return historyView && historyView->HasRewardHistory();
+}
+
+void CAccountsHistoryWriter::OnOwnerRewards(CScript const & owner, DCT_ID const & poolId, RewardType type, CTokenAmount amount, uint32_t begin, uint32_t end)
+{
+    if (IsRecordingRewards()) {
+        rewards.Add(owner, poolId, type, amount, begin, end);
+    }
+}
+
 Res CAccountsHistoryWriter::SubBalance(CScript const & owner, CTokenAmount amount)
 {
     auto res = CCustomCSView::SubBalance(owner, amount);
@@ -86,6 +409,34 @@ bool CAccountsHistoryWriter::Flush()
             burnView->WriteAccountHistory({diff.first, height, txn}, {txid, type, diff.second});
         }
     }
+    if (historyView) {
+        rewards.Write(*historyView, height);
+    }
+    return CCustomCSView::Flush();
+}
+
+CRewardsHistoryWriter::CRewardsHistoryWriter(CCustomCSView & storage, uint32_t height, CAccountsHistoryView* historyView)
+    : CStorageView(new CFlushableStorageKV(static_cast<CStorageKV&>(storage.GetStorage()))), height(height), historyView(historyView)
+{
+}
+
+bool CRewardsHistoryWriter::IsRecordingRewards() const
+{
+    return historyView && historyView->HasRewardHistory();
+}
+
+void CRewardsHistoryWriter::OnOwnerRewards(CScript const & owner, DCT_ID const & poolId, RewardType type, CTokenAmount amount, uint32_t begin, uint32_t end)
+{
+    if (IsRecordingRewards()) {
+        rewards.Add(owner, poolId, type, amount, begin, end);
+    }
+}
+
+bool CRewardsHistoryWriter::Flush()
+{
+    if (historyView) {
+        rewards.Write(*historyView, height);
+    }
     return CCustomCSView::Flush();
 }
 
@@ -52,21 +52,208 @@ struct AccountHistoryValue {
     }
 };
 
+// Secondary index of account history, records are grouped by txid, token or category
+template<typename T>
+struct AccountHistoryIndexKey {
+    T field;
+    AccountHistoryKey key;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(field);
+        READWRITE(key);
+    }
+};
+
+// Number of history records of the owner, with the category and the token in diff,
+// zero category and AnyToken are for any. Empty owner is for records of all owners
+struct AccountHistoryCountKey {
+    static constexpr uint32_t AnyToken = std::numeric_limits<uint32_t>::max();
+
+    CScript owner;
+    uint8_t category;
+    DCT_ID token;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(owner);
+        READWRITE(category);
+        READWRITE(WrapBigEndian(token.v));
+    }
+
+    friend bool operator<(AccountHistoryCountKey const & a, AccountHistoryCountKey const & b) {
+        return std::tie(a.owner, a.category, a.token) < std::tie(b.owner, b.category, b.token);
+    }
+};
+
+// Burnt amounts of records with the category, in the range of heights or of all heights
+struct BurnStatsKey {
+    static constexpr uint32_t AllHeights = std::numeric_limits<uint32_t>::max();
+
+    uint32_t range; // height / BurnStatsInterval
+    uint8_t category;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(WrapBigEndian(range));
+        READWRITE(category);
+    }
+
+    friend bool operator<(BurnStatsKey const & a, BurnStatsKey const & b) {
+        return std::tie(a.range, a.category) < std::tie(b.range, b.category);
+    }
+};
+
+// Rewards of the owner in a pool settled up to the height, exclusive
+struct RewardHistoryKey {
+    CScript owner;
+    uint32_t endHeight;
+    DCT_ID poolID;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(owner);
+
+        if (ser_action.ForRead()) {
+            READWRITE(WrapBigEndian(endHeight));
+            endHeight = ~endHeight;
+        }
+        else {
+            uint32_t endHeight_ = ~endHeight;
+            READWRITE(WrapBigEndian(endHeight_));
+        }
+        READWRITE(WrapBigEndian(poolID.v));
+    }
+};
+
+// Reward per height over [begin, end)
+struct RewardHistoryRange {
+    uint32_t begin;
+    uint32_t end;
+    uint8_t type;
+    CTokenAmount amount;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(VARINT(begin));
+        READWRITE(VARINT(end));
+        READWRITE(type);
+        READWRITE(amount);
+    }
+};
+
+using RewardHistoryValue = std::vector<RewardHistoryRange>;
+
+// Reverse index of rewards by block settled them, they are erased on block disconnection
+struct RewardHistoryHeightKey {
+    uint32_t blockHeight;
+    RewardHistoryKey key;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(WrapBigEndian(blockHeight));
+        READWRITE(key);
+    }
+};
+
 class CAccountsHistoryView : public virtual CStorageView
 {
+    bool secondaryIndexes = false;
+    bool historyCounts = false;
+    bool burnStats = false;
+    bool rewardHistory = false;
+    // storage reads don't see its unflushed writes, counters are changed by whole block
+    std::map<AccountHistoryCountKey, int64_t> countChanges;
+    std::map<BurnStatsKey, TAmounts> burnChanges;
+
+    void UpdateHistoryCounts(AccountHistoryKey const & key, AccountHistoryValue const & value, int64_t change);
+    void UpdateBurnStats(AccountHistoryKey const & key, AccountHistoryValue const & value, int64_t sign);
+
 public:
+    using AccountHistoryCallback = std::function<bool(AccountHistoryKey const &, CLazySerialize<AccountHistoryValue>)>;
+
     Res WriteAccountHistory(AccountHistoryKey const & key, AccountHistoryValue const & value);
     Res EraseAccountHistory(AccountHistoryKey const & key);
-    void ForEachAccountHistory(std::function<bool(AccountHistoryKey const &, CLazySerialize<AccountHistoryValue>)> callback, AccountHistoryKey const & start = {});
+    void ForEachAccountHistory(AccountHistoryCallback callback, AccountHistoryKey const & start = {});
+
+    // secondary indexes are maintained by writes and erases when they are enabled,
+    // they are complete only if enabled on empty database
+    bool HasSecondaryIndexes() const;
+    void EnableSecondaryIndexes();
+    // records with the txid, token or category only, in the same order as ForEachAccountHistory
+    void ForEachAccountHistoryByTxid(uint256 const & txid, AccountHistoryCallback callback, AccountHistoryKey const & start = {});
+    void ForEachAccountHistoryByToken(DCT_ID const & tokenId, AccountHistoryCallback callback, AccountHistoryKey const & start = {});
+    void ForEachAccountHistoryByCategory(uint8_t category, AccountHistoryCallback callback, AccountHistoryKey const & start = {});
+
+    // records counters are maintained like secondary indexes, they are complete only if enabled on empty database
+    bool HasHistoryCounts() const;
+    void EnableHistoryCounts();
+    // number of records of the owner (or all owners if empty) with the category and the token, zero category is for any
+    uint64_t GetAccountHistoryCount(CScript const & owner, uint8_t category = 0, boost::optional<DCT_ID> token = {}) const;
+
+    // burnt amounts by category are summed like records counters, in ranges of heights and in total
+    static constexpr uint32_t BurnStatsInterval = 10000;
+    bool HasBurnStats() const;
+    void EnableBurnStats();
+    // amounts of all records, or of records up to the height, inclusive
+    std::map<uint8_t, TAmounts> GetBurnStats(boost::optional<uint32_t> height = {});
+
+    // counters changes are written with the storage changes
+    bool Flush();
+    void Discard();
+
+    // settled rewards are recorded like secondary indexes, they are complete only if enabled on empty database.
+    // Rewards paid every block before Eunos aren't recorded, readers replay them
+    bool HasRewardHistory() const;
+    void EnableRewardHistory();
+    void WriteRewardHistory(RewardHistoryKey const & key, RewardHistoryValue const & value, uint32_t blockHeight);
+    // erases rewards settled by the block
+    void EraseRewardHistory(uint32_t blockHeight);
+    // rewards of the owner ending at the height or below, from the latest ones
+    void ForEachRewardHistory(CScript const & owner, std::function<bool(uint32_t, DCT_ID const &, CLazySerialize<RewardHistoryValue>)> callback, uint32_t endHeight = std::numeric_limits<uint32_t>::max());
 
     // tags
     struct ByAccountHistoryKey { static const unsigned char prefix; };
+    struct ByRewardHistoryKey { static const unsigned char prefix; };
+    struct ByRewardHistoryHeight { static const unsigned char prefix; };
+    struct ByAccountHistoryTxid { static const unsigned char prefix; };
+    struct ByAccountHistoryToken { static const unsigned char prefix; };
+    struct ByAccountHistoryCategory { static const unsigned char prefix; };
+    struct ByAccountHistoryCount { static const unsigned char prefix; };
+    struct ByBurnStats { static const unsigned char prefix; };
+    struct ByHistoryFeatures { static const unsigned char prefix; };
+
+private:
+    template<typename By, typename T>
+    void ForEachIndexedHistory(T const & field, AccountHistoryCallback callback, AccountHistoryKey const & start);
+};
+
+// Settled rewards collected by a view, they are written with its changes
+class CRewardsHistoryCollector
+{
+    std::vector<std::pair<RewardHistoryKey, RewardHistoryValue>> rewards;
+
+public:
+    void Add(CScript const & owner, DCT_ID const & poolId, RewardType type, CTokenAmount amount, uint32_t begin, uint32_t end);
+    void Write(CAccountsHistoryView & historyView, uint32_t blockHeight);
 };
 
 class CAccountHistoryStorage : public CAccountsHistoryView
 {
 public:
-    CAccountHistoryStorage(const fs::path& dbName, std::size_t cacheSize, bool fMemory = false, bool fWipe = false);
+    CAccountHistoryStorage(const fs::path& dbName, std::size_t cacheSize, bool fMemory = false, bool fWipe = false, bool fSecondaryIndexes = false);
 };
 
 class CBurnHistoryStorage : public CAccountsHistoryView
@@ -86,11 +273,29 @@ class CAccountsHistoryWriter : public CCustomCSView
     CAccountsHistoryView* historyView;
     CAccountsHistoryView* burnView;
 
+    CRewardsHistoryCollector rewards;
+
 public:
     CAccountsHistoryWriter(CCustomCSView & storage, uint32_t height, uint32_t txn, const uint256& txid, uint8_t type, CAccountsHistoryView* historyView, CAccountsHistoryView* burnView);
     Res AddBalance(CScript const & owner, CTokenAmount amount) override;
     Res SubBalance(CScript const & owner, CTokenAmount amount) override;
     Res AddFeeBurn(CScript const & owner, CAmount amount);
+    bool IsRecordingRewards() const override;
+    void OnOwnerRewards(CScript const & owner, DCT_ID const & poolId, RewardType type, CTokenAmount amount, uint32_t begin, uint32_t end) override;
+    bool Flush();
+};
+
+// Records rewards settled by block level changes
+class CRewardsHistoryWriter : public CCustomCSView
+{
+    const uint32_t height;
+    CAccountsHistoryView* historyView;
+    CRewardsHistoryCollector rewards;
+
+public:
+    CRewardsHistoryWriter(CCustomCSView & storage, uint32_t height, CAccountsHistoryView* historyView);
+    bool IsRecordingRewards() const override;
+    void OnOwnerRewards(CScript const & owner, DCT_ID const & poolId, RewardType type, CTokenAmount amount, uint32_t begin, uint32_t end) override;
     bool Flush();
 };
 
@@ -114,5 +319,6 @@ extern std::unique_ptr<CAccountHistoryStorage> paccountHistoryDB;
 extern std::unique_ptr<CBurnHistoryStorage> pburnHistoryDB;
 
 static constexpr bool DEFAULT_ACINDEX = true;
+static constexpr bool DEFAULT_ACINDEX_SECONDARY = false;
 
 #endif //DEFI_MASTERNODES_ACCOUNTSHISTORY_H
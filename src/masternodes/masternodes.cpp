@@ -13,6 +13,7 @@
 #include <primitives/transaction.h>
 #include <script/script.h>
 #include <script/standard.h>
+#include <util/parallel.h>
 #include <validation.h>
 #include <wallet/wallet.h>
 #include <wallet/walletutil.h>
@@ -29,6 +30,7 @@ const unsigned char DB_MN_OWNERS = 'w';       // masternodes' owners index
 const unsigned char DB_MN_STAKER = 'X';       // masternodes' last staked block time
 const unsigned char DB_MN_HEIGHT = 'H';       // single record with last processed chain height
 const unsigned char DB_MN_VERSION = 'D';
+const unsigned char DB_MN_FLUSH_EPOCH = 'E'; // single record with the block of on disk state
 const unsigned char DB_MN_ANCHOR_REWARD = 'r';
 const unsigned char DB_MN_ANCHOR_CONFIRM = 'x';
 const unsigned char DB_MN_CURRENT_TEAM = 't';
@@ -605,6 +607,56 @@ void CCustomCSView::SetDbVersion(int version)
     Write(DB_MN_VERSION, version);
 }
 
+void CCustomCSView::SetFlushEpoch(CFlushEpoch const & epoch)
+{
+    Write(DB_MN_FLUSH_EPOCH, epoch);
+}
+
+boost::optional<CFlushEpoch> CCustomCSView::GetFlushEpoch() const
+{
+    CFlushEpoch epoch;
+    if (Read(DB_MN_FLUSH_EPOCH, epoch))
+        return epoch;
+    return {};
+}
+
+CCustomCSSnapshot GetCustomCSSnapshot()
+{
+    LOCK(cs_main);
+    auto tip = ::ChainActive().Tip();
+    assert(tip);
+    // copy of in-memory changes is made once per block
+    auto storage = pcustomcsDB->Snapshot(pcustomcsview->GetStorage().GetRaw(), tip->GetBlockHash());
+    return {storage, tip->GetBlockHash(), tip->nHeight, tip->GetBlockTime()};
+}
+
+std::vector<CStorageTableGroup> CCustomCSView::TableGroups()
+{
+    // undo is written every block and pruned soon, it is never read in hot path
+    CDBTuning undoTuning;
+    undoTuning.blockSize = 64 << 10;
+    undoTuning.writeBufferSize = 16 << 20;
+    undoTuning.compression = true;
+
+    // balances are read by almost every tx, small blocks suit point lookups
+    CDBTuning balancesTuning;
+    balancesTuning.blockSize = 4 << 10;
+
+    // pool state, shares and reward history are scanned in ranges every block
+    CDBTuning poolsTuning;
+    poolsTuning.blockSize = 16 << 10;
+
+    return {
+        {"undo", {CUndosView::ByUndoKey::prefix}, undoTuning, 10},
+        {"balances", {CAccountsView::ByBalanceKey::prefix, CAccountsView::ByHeightKey::prefix}, balancesTuning, 30},
+        {"pools", {CPoolPairView::ByID::prefix, CPoolPairView::ByPair::prefix, CPoolPairView::ByShare::prefix,
+                   CPoolPairView::ByIDPair::prefix, CPoolPairView::ByPoolSwap::prefix, CPoolPairView::ByReserves::prefix,
+                   CPoolPairView::ByRewardPct::prefix, CPoolPairView::ByPoolReward::prefix, CPoolPairView::ByDailyReward::prefix,
+                   CPoolPairView::ByCustomReward::prefix, CPoolPairView::ByTotalLiquidity::prefix,
+                   CPoolPairView::ByOwnerShare::prefix, CPoolPairView::ByOwnerShareIndex::prefix}, poolsTuning, 20},
+    };
+}
+
 CTeamView::CTeam CCustomCSView::CalcNextTeam(const uint256 & stakeModifier)
 {
     if (stakeModifier == uint256())
@@ -749,17 +801,18 @@ bool CCustomCSView::CalculateOwnerRewards(CScript const & owner, uint32_t target
     if (balanceHeight >= targetHeight) {
         return false;
     }
-    ForEachPoolId([&] (DCT_ID const & poolId) {
-        auto height = GetShare(poolId, owner);
-        if (!height || *height >= targetHeight) {
-            return true; // no share or target height is before a pool share' one
+    ForEachOwnerShare(owner, [&] (DCT_ID const & poolId, uint32_t height) {
+        if (height >= targetHeight) {
+            return true; // target height is before a pool share' one
         }
         auto onLiquidity = [&]() -> CAmount {
             return GetBalance(owner, poolId).nValue;
         };
-        auto beginHeight = std::max(*height, balanceHeight);
-        CalculatePoolRewards(poolId, onLiquidity, beginHeight, targetHeight,
-            [&](RewardType, CTokenAmount amount, uint32_t height) {
+        auto beginHeight = std::max(height, balanceHeight);
+        CalculatePoolRewardRanges(poolId, onLiquidity, beginHeight, targetHeight,
+            [&](RewardType type, CTokenAmount amount, uint32_t begin, uint32_t end) {
+                OnOwnerRewards(owner, poolId, type, amount, begin, end);
+                amount.nValue *= (end - begin);
                 auto res = AddBalance(owner, amount);
                 if (!res) {
                     LogPrintf("Pool rewards: can't update balance of %s: %s, height %ld\n", owner.GetHex(), res.msg, targetHeight);
@@ -772,15 +825,139 @@ bool CCustomCSView::CalculateOwnerRewards(CScript const & owner, uint32_t target
     return UpdateBalancesHeight(owner, targetHeight);
 }
 
+bool CCustomCSView::CalculateOwnerRewards(std::vector<CScript> owners, uint32_t targetHeight)
+{
+    struct RecordedReward {
+        DCT_ID poolId;
+        RewardType type;
+        CTokenAmount amount;
+        uint32_t begin;
+        uint32_t end;
+    };
+    struct OwnerRewards {
+        CScript owner;
+        uint32_t balanceHeight;
+        CBalances rewards;
+        std::vector<RecordedReward> recorded;
+    };
+    std::sort(owners.begin(), owners.end());
+    owners.erase(std::unique(owners.begin(), owners.end()), owners.end());
+
+    std::vector<OwnerRewards> states;
+    for (auto& owner : owners) {
+        auto balanceHeight = GetBalancesHeight(owner);
+        if (balanceHeight < targetHeight) {
+            states.push_back({std::move(owner), balanceHeight, {}, {}});
+        }
+    }
+    if (states.empty()) {
+        return false;
+    }
+
+    // pool state is read once per pool and shared by its owners, owners are settled independently
+    constexpr const size_t RangesPerPass = 4096;
+    constexpr const size_t MinOwnersPerThread = 16;
+    const auto recording = IsRecordingRewards();
+
+    struct Share {
+        OwnerRewards* state;
+        uint32_t beginHeight;
+        CAmount liquidity;
+    };
+    std::map<DCT_ID, std::vector<Share>> poolShares;
+    for (auto& state : states) {
+        ForEachOwnerShare(state.owner, [&](DCT_ID const & poolId, uint32_t height) {
+            if (height < targetHeight) { // skip shares created at or after target height
+                poolShares[poolId].push_back({&state, std::max(height, state.balanceHeight), GetBalance(state.owner, poolId).nValue});
+            }
+            return true;
+        });
+    }
+
+    for (const auto& pool : poolShares) {
+        const auto& poolId = pool.first;
+        const auto& shares = pool.second;
+        auto beginHeight = targetHeight;
+        for (const auto& share : shares) {
+            beginHeight = std::min(beginHeight, share.beginHeight);
+        }
+        auto tokenIds = ReadBy<ByIDPair, ByPairKey>(poolId);
+        assert(tokenIds); // contract to verify pool data
+
+        std::vector<PoolRewardsRange> ranges;
+        auto settle = [&]() {
+            ParallelFor(shares.size(), MinOwnersPerThread, [&](size_t begin, size_t end) {
+                std::vector<const Share*> active;
+                std::vector<CAmount> liquidity, rewards;
+                for (const auto& range : ranges) {
+                    active.clear();
+                    liquidity.clear();
+                    for (auto i = begin; i < end; ++i) {
+                        const auto& share = shares[i];
+                        if (range.end <= share.beginHeight) {
+                            continue;
+                        }
+                        // owner's liquidity includes rewards in pool token calculated so far
+                        const auto& balances = share.state->rewards.balances;
+                        auto it = balances.find(poolId);
+                        active.push_back(&share);
+                        liquidity.push_back(share.liquidity + (it != balances.end() ? it->second : 0));
+                    }
+                    rewards.resize(liquidity.size());
+                    auto dailyReward = range.poolReward != 0; // it goes first
+                    CalculateRangeRewards(*tokenIds, range, liquidity.data(), liquidity.size(), rewards.data(), [&](RewardType type, DCT_ID tokenId) {
+                        for (size_t i = 0; i < active.size(); ++i) {
+                            const auto rangeBegin = std::max(range.begin, active[i]->beginHeight);
+                            active[i]->state->rewards.Add({tokenId, rewards[i] * (range.end - rangeBegin)});
+                            // the same rewards as reported by single owner settlement
+                            if (recording && (rewards[i] != 0 || type == RewardType::Commission || dailyReward)) {
+                                active[i]->state->recorded.push_back({poolId, type, {tokenId, rewards[i]}, rangeBegin, range.end});
+                            }
+                        }
+                        dailyReward = false;
+                    });
+                }
+            });
+            ranges.clear();
+        };
+        ForEachPoolRewardsRange(poolId, beginHeight, targetHeight, [&](PoolRewardsRange const & range) {
+            ranges.push_back(range);
+            if (ranges.size() == RangesPerPass) {
+                settle();
+            }
+            return true;
+        });
+        settle();
+    }
+
+    for (const auto& state : states) {
+        for (const auto& reward : state.recorded) {
+            OnOwnerRewards(state.owner, reward.poolId, reward.type, reward.amount, reward.begin, reward.end);
+        }
+        for (const auto& reward : state.rewards.balances) {
+            auto res = AddBalance(state.owner, {reward.first, reward.second});
+            if (!res) {
+                LogPrintf("Pool rewards: can't update balance of %s: %s, height %ld\n", state.owner.GetHex(), res.msg, targetHeight);
+            }
+        }
+        UpdateBalancesHeight(state.owner, targetHeight);
+    }
+    return true;
+}
+
 uint256 CCustomCSView::MerkleRoot() {
     auto& rawMap = GetStorage().GetRaw();
-    if (rawMap.empty()) {
-        return {};
+    auto hashes = rawMap.EntryHashes();
+    // owner shares index is built locally, it is not a part of consensus state
+    size_t pos = 0, kept = 0;
+    for (auto it = rawMap.begin(); it != rawMap.end(); ++it, ++pos) {
+        if (it->first[0] != ByOwnerShare::prefix) {
+            hashes[kept++] = hashes[pos];
+        }
     }
-    std::vector<uint256> hashes;
-    for (const auto& it : rawMap) {
-        auto value = it.second ? *it.second : TBytes{};
-        hashes.push_back(Hash2(it.first, value));
+    hashes.resize(kept);
+    if (hashes.empty()) {
+        return {};
     }
     return ComputeMerkleRoot(std::move(hashes));
 }
@@ -234,6 +234,22 @@ public:
     struct BtcTx { static const unsigned char prefix; };
 };
 
+// Marks the state written to disk, it is flushed in the same batch as the state.
+// It only detects the state behind the coins tip, such state isn't replayed
+struct CFlushEpoch
+{
+    uint64_t epoch = 0;
+    uint256 blockHash;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(epoch);
+        READWRITE(blockHash);
+    }
+};
+
 class CCustomCSView
         : public CMasternodesView
         , public CLastHeightView
@@ -279,13 +295,22 @@ public:
     bool CanSpend(const uint256 & txId, int height) const;
 
     bool CalculateOwnerRewards(CScript const & owner, uint32_t height);
+    // settles owners in one pass per pool, owners' calculations are spread over worker threads
+    bool CalculateOwnerRewards(std::vector<CScript> owners, uint32_t height);
 
     void SetDbVersion(int version);
 
     int GetDbVersion() const;
 
+    void SetFlushEpoch(CFlushEpoch const & epoch);
+
+    boost::optional<CFlushEpoch> GetFlushEpoch() const;
+
     uint256 MerkleRoot();
 
+    // Table groups which can be stored in separate leveldb instances, see -customtables
+    static std::vector<CStorageTableGroup> TableGroups();
+
     // we construct it as it
     CFlushableStorageKV& GetStorage() {
         return static_cast<CFlushableStorageKV&>(DB());
@@ -298,4 +323,17 @@ std::map<CKeyID, CKey> AmISignerNow(CAnchorData::CTeam const & team);
 extern std::unique_ptr<CStorageLevelDB> pcustomcsDB;
 extern std::unique_ptr<CCustomCSView> pcustomcsview;
 
+/** Read-only state of enhanced chainstate at a block, it can be used without cs_main */
+struct CCustomCSSnapshot
+{
+    std::shared_ptr<CStorageKV> storage;
+    uint256 blockHash;
+    int height;
+    int64_t blockTime;
+};
+
+/** Snapshot at the chain tip, it's shared by callers until the tip is changed.
+ *  Use it as a base of CCustomCSView for read-only scans */
+CCustomCSSnapshot GetCustomCSSnapshot();
+
 #endif // DEFI_MASTERNODES_MASTERNODES_H
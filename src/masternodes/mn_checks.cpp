@@ -383,6 +383,25 @@ public:
     }
 };
 
+// Proxy view of owners settlement, balances changes aren't recorded by history writer but settled rewards are
+class CRewardsProxyView : public CCustomCSView
+{
+    CCustomCSView& parent;
+
+public:
+    explicit CRewardsProxyView(CCustomCSView& parent)
+        : CStorageView(new CFlushableStorageKV(static_cast<CStorageKV&>(parent.GetStorage()))), parent(parent)
+    {}
+
+    bool IsRecordingRewards() const override {
+        return parent.IsRecordingRewards();
+    }
+
+    void OnOwnerRewards(CScript const & owner, DCT_ID const & poolId, RewardType type, CTokenAmount amount, uint32_t begin, uint32_t end) override {
+        parent.OnOwnerRewards(owner, poolId, type, amount, begin, end);
+    }
+};
+
 class CCustomTxVisitor : public boost::static_visitor<Res>
 {
 protected:
@@ -599,7 +618,7 @@ public:
 
     // we need proxy view to prevent add/sub balance record
     void CalculateOwnerRewards(const CScript& owner) const {
-        CCustomCSView view(mnview);
+        CRewardsProxyView view(mnview);
         view.CalculateOwnerRewards(owner, height);
         view.Flush();
     }
@@ -0,0 +1,97 @@
+// Copyright (c) DeFi Blockchain Developers
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+
+#include <masternodes/poolhistory.h>
+#include <masternodes/mn_checks.h>
+#include <chainparams.h>
+
+/// @Note it's in own database
+const unsigned char CPoolHistoryView::ByPoolHistory::prefix = 'p';
+
+void CPoolHistoryView::WritePoolHistory(DCT_ID const & poolId, uint32_t height, PoolHistoryValue const & value)
+{
+    WriteBy<ByPoolHistory>(PoolHeightKey{poolId, height}, value);
+}
+
+void CPoolHistoryView::ErasePoolHistory(DCT_ID const & poolId, uint32_t height)
+{
+    EraseBy<ByPoolHistory>(PoolHeightKey{poolId, height});
+}
+
+void CPoolHistoryView::ForEachPoolHistory(DCT_ID const & poolId, std::function<bool(uint32_t, PoolHistoryValue const &)> callback, uint32_t height)
+{
+    // heights are stored inverted, iteration goes from the latest record
+    for (auto it = LowerBound<ByPoolHistory>(PoolHeightKey{poolId, height}); it.Valid() && it.Key().poolID == poolId; it.Next()) {
+        PoolHistoryValue value = it.Value();
+        if (!callback(it.Key().height, value)) {
+            break;
+        }
+    }
+}
+
+void CPoolHistoryView::WriteBlockHistory(CCustomCSView & view, uint32_t height, PoolSwapVolumes const & volumes)
+{
+    view.ForEachPoolPair([&](DCT_ID const & poolId, CPoolPair pool) {
+        PoolHistoryValue value;
+        value.reserveA = pool.reserveA;
+        value.reserveB = pool.reserveB;
+        value.totalLiquidity = pool.totalLiquidity;
+        auto it = volumes.find(poolId);
+        if (it != volumes.end()) {
+            value.volumeA = it->second.first;
+            value.volumeB = it->second.second;
+        }
+        bool changed = true;
+        if (height > 0 && value.volumeA == 0 && value.volumeB == 0) {
+            ForEachPoolHistory(poolId, [&](uint32_t, PoolHistoryValue const & prev) {
+                changed = prev.reserveA != value.reserveA
+                       || prev.reserveB != value.reserveB
+                       || prev.totalLiquidity != value.totalLiquidity;
+                return false;
+            }, height - 1);
+        }
+        if (changed) {
+            WritePoolHistory(poolId, height, value);
+        }
+        return true;
+    });
+}
+
+void CPoolHistoryView::EraseBlockHistory(CCustomCSView & view, uint32_t height)
+{
+    view.ForEachPoolId([&](DCT_ID const & poolId) {
+        ErasePoolHistory(poolId, height);
+        return true;
+    });
+}
+
+CPoolHistoryStorage::CPoolHistoryStorage(const fs::path& dbName, std::size_t cacheSize, bool fMemory, bool fWipe)
+    : CStorageView(new CStorageLevelDB(dbName, cacheSize, fMemory, fWipe))
+{
+}
+
+void AddPoolSwapVolume(CCustomCSView & view, CTransaction const & tx, uint32_t height, PoolSwapVolumes & volumes)
+{
+    std::vector<unsigned char> metadata;
+    if (GuessCustomTxType(tx, metadata) != CustomTxType::PoolSwap) {
+        return;
+    }
+    auto txMessage = customTypeToMessage(CustomTxType::PoolSwap);
+    if (!CustomMetadataParse(height, Params().GetConsensus(), metadata, txMessage)) {
+        return;
+    }
+    auto const & obj = boost::get<CPoolSwapMessage>(txMessage);
+    auto pool = view.GetPoolPair(obj.idTokenFrom, obj.idTokenTo);
+    if (!pool) {
+        return;
+    }
+    auto& volume = volumes[pool->first];
+    if (obj.idTokenFrom == pool->second.idTokenA) {
+        volume.first += obj.amountFrom;
+    } else {
+        volume.second += obj.amountFrom;
+    }
+}
+
+std::unique_ptr<CPoolHistoryStorage> ppoolHistoryDB;
@@ -0,0 +1,69 @@
+// Copyright (c) DeFi Blockchain Developers
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DEFI_MASTERNODES_POOLHISTORY_H
+#define DEFI_MASTERNODES_POOLHISTORY_H
+
+#include <amount.h>
+#include <flushablestorage.h>
+#include <masternodes/masternodes.h>
+
+#include <map>
+
+class CTransaction;
+
+// Pool state at the end of a block and swap volume of the block
+struct PoolHistoryValue {
+    CAmount reserveA = 0;
+    CAmount reserveB = 0;
+    CAmount totalLiquidity = 0;
+    CAmount volumeA = 0;
+    CAmount volumeB = 0;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(VARINT(reserveA, VarIntMode::NONNEGATIVE_SIGNED));
+        READWRITE(VARINT(reserveB, VarIntMode::NONNEGATIVE_SIGNED));
+        READWRITE(VARINT(totalLiquidity, VarIntMode::NONNEGATIVE_SIGNED));
+        READWRITE(VARINT(volumeA, VarIntMode::NONNEGATIVE_SIGNED));
+        READWRITE(VARINT(volumeB, VarIntMode::NONNEGATIVE_SIGNED));
+    }
+};
+
+// Gross amounts swapped into pools within a block
+using PoolSwapVolumes = std::map<DCT_ID, std::pair<CAmount, CAmount>>;
+
+class CPoolHistoryView : public virtual CStorageView
+{
+public:
+    void WritePoolHistory(DCT_ID const & poolId, uint32_t height, PoolHistoryValue const & value);
+    void ErasePoolHistory(DCT_ID const & poolId, uint32_t height);
+    // visits records of the pool from the height down to pool creation
+    void ForEachPoolHistory(DCT_ID const & poolId, std::function<bool(uint32_t, PoolHistoryValue const &)> callback, uint32_t height = UINT_MAX);
+
+    // a record is written only if the pool changed in the block, unchanged heights repeat the previous record
+    void WriteBlockHistory(CCustomCSView & view, uint32_t height, PoolSwapVolumes const & volumes);
+    // it should be called before block's pools changes are reverted
+    void EraseBlockHistory(CCustomCSView & view, uint32_t height);
+
+    // tags
+    struct ByPoolHistory { static const unsigned char prefix; };
+};
+
+class CPoolHistoryStorage : public CPoolHistoryView
+{
+public:
+    CPoolHistoryStorage(const fs::path& dbName, std::size_t cacheSize, bool fMemory = false, bool fWipe = false);
+};
+
+// Adds amount of the pool swap transaction, it should be applied successfully
+void AddPoolSwapVolume(CCustomCSView & view, CTransaction const & tx, uint32_t height, PoolSwapVolumes & volumes);
+
+extern std::unique_ptr<CPoolHistoryStorage> ppoolHistoryDB;
+
+static constexpr bool DEFAULT_POOLHISTORYINDEX = false;
+
+#endif //DEFI_MASTERNODES_POOLHISTORY_H
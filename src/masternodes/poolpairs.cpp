@@ -6,6 +6,8 @@
 #include <masternodes/poolpairs.h>
 #include <core_io.h>
 #include <primitives/transaction.h>
+#include <sync.h>
+#include <util/parallel.h>
 
 const unsigned char CPoolPairView::ByID                 ::prefix = 'i';
 const unsigned char CPoolPairView::ByPair               ::prefix = 'j';
@@ -18,6 +20,8 @@ const unsigned char CPoolPairView::ByPoolReward         ::prefix = 'I';
 const unsigned char CPoolPairView::ByDailyReward        ::prefix = 'B';
 const unsigned char CPoolPairView::ByCustomReward       ::prefix = 'A';
 const unsigned char CPoolPairView::ByTotalLiquidity     ::prefix = 'f';
+const unsigned char CPoolPairView::ByOwnerShare         ::prefix = 'K';
+const unsigned char CPoolPairView::ByOwnerShareIndex    ::prefix = 'W';
 
 struct PoolSwapValue {
     bool swapEvent;
@@ -185,10 +189,40 @@ boost::optional<std::pair<DCT_ID, CPoolPair> > CPoolPairView::GetPoolPair(const
     return {};
 }
 
-inline CAmount liquidityReward(CAmount reward, CAmount liquidity, CAmount totalLiquidity) {
+CAmount liquidityReward(CAmount reward, CAmount liquidity, CAmount totalLiquidity) {
     return static_cast<CAmount>((arith_uint256(reward) * arith_uint256(liquidity) / arith_uint256(totalLiquidity)).GetLow64());
 }
 
+void CalculateLiquidityRewards(CAmount reward, CAmount totalLiquidity, CAmount const * liquidity, CAmount * rewards, size_t count, bool newCalculation) {
+    if (!newCalculation) {
+        constexpr const uint32_t PRECISION = 10000;
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t liqWeight = liquidity[i] * PRECISION / totalLiquidity;
+            rewards[i] = reward * liqWeight / PRECISION;
+        }
+        return;
+    }
+#ifdef __SIZEOF_INT128__
+    if (totalLiquidity != 0) {
+        using uint128_t = unsigned __int128;
+        const auto total = uint64_t(totalLiquidity);
+        for (size_t i = 0; i < count; ++i) {
+            const auto product = uint128_t(uint64_t(reward)) * uint64_t(liquidity[i]);
+            // quotient doesn't fit 64 bits, leave it to arith_uint256
+            if (uint64_t(product >> 64) >= total) {
+                rewards[i] = liquidityReward(reward, liquidity[i], totalLiquidity);
+            } else {
+                rewards[i] = CAmount(uint64_t(product / total));
+            }
+        }
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        rewards[i] = liquidityReward(reward, liquidity[i], totalLiquidity);
+    }
+}
+
 template<typename TIterator, typename ValueType>
 void ReadValueMoveToNext(TIterator & it, DCT_ID poolId, ValueType & value, uint32_t & height) {
 
@@ -208,15 +242,31 @@ void ReadValueMoveToNext(TIterator & it, DCT_ID poolId, ValueType & value, uint3
 }
 
 void CPoolPairView::CalculatePoolRewards(DCT_ID const & poolId, std::function<CAmount()> onLiquidity, uint32_t begin, uint32_t end, std::function<void(RewardType, CTokenAmount, uint32_t)> onReward) {
+    CalculatePoolRewardRanges(poolId, onLiquidity, begin, end, [&](RewardType type, CTokenAmount amount, uint32_t begin, uint32_t end) {
+        for (auto height = begin; height < end; ++height) {
+            onReward(type, amount, height);
+        }
+    });
+}
+
+void CPoolPairView::CalculatePoolRewardRanges(DCT_ID const & poolId, std::function<CAmount()> onLiquidity, uint32_t begin, uint32_t end, std::function<void(RewardType, CTokenAmount, uint32_t, uint32_t)> onRewards) {
+    auto tokenIds = ReadBy<ByIDPair, ByPairKey>(poolId);
+    assert(tokenIds); // contract to verify pool data
+
+    ForEachPoolRewardsRange(poolId, begin, end, [&](PoolRewardsRange const & range) {
+        CalculateRangeRewards(*tokenIds, range, onLiquidity(), [&](RewardType type, CTokenAmount amount) {
+            onRewards(type, amount, range.begin, range.end);
+        });
+        return true;
+    });
+}
+
+void CPoolPairView::ForEachPoolRewardsRange(DCT_ID const & poolId, uint32_t begin, uint32_t end, std::function<bool(PoolRewardsRange const &)> callback) {
     if (begin >= end) {
         return;
     }
-    constexpr const uint32_t PRECISION = 10000;
     const auto newCalcHeight = uint32_t(Params().GetConsensus().BayfrontGardensHeight);
 
-    auto tokenIds = ReadBy<ByIDPair, ByPairKey>(poolId);
-    assert(tokenIds); // contract to verify pool data
-
     PoolHeightKey poolKey = {poolId, begin};
 
     CAmount poolReward = 0;
@@ -257,39 +307,64 @@ void CPoolPairView::CalculatePoolRewards(DCT_ID const & poolId, std::function<CA
         while (height >= nextCustomRewards) {
             ReadValueMoveToNext(itCustomRewards, poolId, customRewards, nextCustomRewards);
         }
-        const auto liquidity = onLiquidity();
-        // daily rewards
-        if (poolReward != 0) {
-            CAmount providerReward = 0;
-            if (height < newCalcHeight) { // old calculation
-                uint32_t liqWeight = liquidity * PRECISION / totalLiquidity;
-                providerReward = poolReward * liqWeight / PRECISION;
-            } else { // new calculation
-                providerReward = liquidityReward(poolReward, liquidity, totalLiquidity);
-            }
-            onReward(RewardType::Rewards, {DCT_ID{0}, providerReward}, height);
-        }
-        // commissions
-        if (poolSwapHeight == height && poolSwap.swapEvent) {
-            CAmount feeA, feeB;
-            if (height < newCalcHeight) {
-                uint32_t liqWeight = liquidity * PRECISION / totalLiquidity;
-                feeA = poolSwap.blockCommissionA * liqWeight / PRECISION;
-                feeB = poolSwap.blockCommissionB * liqWeight / PRECISION;
-            } else {
-                feeA = liquidityReward(poolSwap.blockCommissionA, liquidity, totalLiquidity);
-                feeB = liquidityReward(poolSwap.blockCommissionB, liquidity, totalLiquidity);
-            }
-            onReward(RewardType::Commission, {tokenIds->idTokenA, feeA}, height);
-            onReward(RewardType::Commission, {tokenIds->idTokenB, feeB}, height);
+        PoolRewardsRange range;
+        range.begin = height;
+        // pool state is the same till the next change, so is per height reward,
+        // swap heights and rewards in pool's own token (owner liquidity grows) go one by one
+        range.end = std::min({end, nextTotalLiquidity, nextPoolReward, nextPoolSwap, nextCustomRewards});
+        if (height < newCalcHeight) {
+            range.end = std::min(range.end, newCalcHeight);
         }
-        // custom rewards
-        for (const auto& reward : customRewards.balances) {
-            if (auto providerReward = liquidityReward(reward.second, liquidity, totalLiquidity)) {
-                onReward(RewardType::Rewards, {reward.first, providerReward}, height);
-            }
+        range.swapEvent = poolSwapHeight == height && poolSwap.swapEvent;
+        if (range.swapEvent || customRewards.balances.count(poolId)) {
+            range.end = height + 1;
+        }
+        range.totalLiquidity = totalLiquidity;
+        range.poolReward = poolReward;
+        if (range.swapEvent) {
+            range.blockCommissionA = poolSwap.blockCommissionA;
+            range.blockCommissionB = poolSwap.blockCommissionB;
+        }
+        range.customRewards = customRewards;
+        if (!callback(range)) {
+            break;
+        }
+        height = range.end;
+    }
+}
+
+void CPoolPairView::CalculateRangeRewards(ByPairKey const & tokenIds, PoolRewardsRange const & range, CAmount liquidity, std::function<void(RewardType, CTokenAmount)> onReward) {
+    CAmount reward;
+    auto dailyReward = range.poolReward != 0; // it goes first
+    CalculateRangeRewards(tokenIds, range, &liquidity, 1, &reward, [&](RewardType type, DCT_ID tokenId) {
+        // daily reward and commissions are reported even if they are zero
+        if (reward != 0 || type == RewardType::Commission || dailyReward) {
+            onReward(type, {tokenId, reward});
         }
-        ++height;
+        dailyReward = false;
+    });
+}
+
+void CPoolPairView::CalculateRangeRewards(ByPairKey const & tokenIds, PoolRewardsRange const & range, CAmount const * liquidity, size_t count, CAmount * rewards, std::function<void(RewardType, DCT_ID)> onRewards) {
+    const auto newCalculation = range.begin >= uint32_t(Params().GetConsensus().BayfrontGardensHeight);
+    const auto totalLiquidity = range.totalLiquidity;
+
+    // daily rewards
+    if (range.poolReward != 0) {
+        CalculateLiquidityRewards(range.poolReward, totalLiquidity, liquidity, rewards, count, newCalculation);
+        onRewards(RewardType::Rewards, DCT_ID{0});
+    }
+    // commissions
+    if (range.swapEvent) {
+        CalculateLiquidityRewards(range.blockCommissionA, totalLiquidity, liquidity, rewards, count, newCalculation);
+        onRewards(RewardType::Commission, tokenIds.idTokenA);
+        CalculateLiquidityRewards(range.blockCommissionB, totalLiquidity, liquidity, rewards, count, newCalculation);
+        onRewards(RewardType::Commission, tokenIds.idTokenB);
+    }
+    // custom rewards
+    for (const auto& reward : range.customRewards.balances) {
+        CalculateLiquidityRewards(reward.second, totalLiquidity, liquidity, rewards, count);
+        onRewards(RewardType::Rewards, reward.first);
     }
 }
 
@@ -450,23 +525,60 @@ CAmount CPoolPairView::UpdatePoolRewards(std::function<CTokenAmount(CScript cons
     bool newCustomRewards = nHeight >= Params().GetConsensus().ClarkeQuayHeight;
 
     constexpr uint32_t const PRECISION = 10000; // (== 100%) just searching the way to avoid arith256 inflating
+    // below that a thread costs more than pool state reads
+    constexpr const size_t MinPoolsPerThread = 16;
     CAmount totalDistributed = 0;
 
+    // pool state at the height, it isn't changed by other pools updates
+    struct PoolState {
+        DCT_ID poolId;
+        CBalances rewards;
+        boost::optional<CScript> ownerAddress;
+        CBalances customRewards;
+        CAmount totalLiquidity = 0;
+        boost::optional<PoolSwapValue> swapValue;
+        CAmount poolReward = 0;
+    };
+    std::vector<PoolState> states;
     ForEachPoolId([&] (DCT_ID const & poolId) {
+        states.emplace_back();
+        states.back().poolId = poolId;
+        return true;
+    });
+
+    // read phase, pools are read in parallel while the view isn't changed
+    ParallelFor(states.size(), MinPoolsPerThread, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            auto& state = states[i];
+            PoolHeightKey poolKey = {state.poolId, uint32_t(nHeight)};
+            if (newCustomRewards) {
+                if (auto pool = ReadBy<ByID, CPoolPair>(state.poolId)) {
+                    state.rewards = std::move(pool->rewards);
+                    state.ownerAddress = std::move(pool->ownerAddress);
+                }
+                state.customRewards = ReadValueAt<ByCustomReward, CBalances>(this, poolKey);
+            }
+            state.totalLiquidity = ReadValueAt<ByTotalLiquidity, CAmount>(this, poolKey);
+            if (!state.totalLiquidity) {
+                continue;
+            }
+            state.swapValue = ReadBy<ByPoolSwap, PoolSwapValue>(poolKey);
+            state.poolReward = ReadValueAt<ByPoolReward, CAmount>(this, poolKey);
+        }
+    });
+
+    // write phase in pool order, owners balances are shared by pools
+    for (auto& state : states) {
+        const auto& poolId = state.poolId;
 
         CAmount distributedFeeA = 0;
         CAmount distributedFeeB = 0;
-        boost::optional<CScript> ownerAddress;
+        auto& ownerAddress = state.ownerAddress;
 
         PoolHeightKey poolKey = {poolId, uint32_t(nHeight)};
 
-        CBalances rewards;
+        auto& rewards = state.rewards;
         if (newCustomRewards) {
-            if (auto pool = ReadBy<ByID, CPoolPair>(poolId)) {
-                rewards = std::move(pool->rewards);
-                ownerAddress = std::move(pool->ownerAddress);
-            }
-
             for (auto it = rewards.balances.begin(), next_it = it; it != rewards.balances.end(); it = next_it) {
                 ++next_it;
 
@@ -479,19 +591,19 @@ CAmount CPoolPairView::UpdatePoolRewards(std::function<CTokenAmount(CScript cons
                 }
             }
 
-            if (rewards != ReadValueAt<ByCustomReward, CBalances>(this, poolKey)) {
+            if (rewards != state.customRewards) {
                 WriteBy<ByCustomReward>(poolKey, rewards);
             }
         }
 
-        auto totalLiquidity = ReadValueAt<ByTotalLiquidity, CAmount>(this, poolKey);
+        const auto totalLiquidity = state.totalLiquidity;
         if (!totalLiquidity) {
-            return true;
+            continue;
         }
 
-        auto swapValue = ReadBy<ByPoolSwap, PoolSwapValue>(poolKey);
+        auto& swapValue = state.swapValue;
         const auto swapEvent = swapValue && swapValue->swapEvent;
-        auto poolReward = ReadValueAt<ByPoolReward, CAmount>(this, poolKey);
+        const auto poolReward = state.poolReward;
 
         if (newRewardLogic) {
 
@@ -511,7 +623,7 @@ CAmount CPoolPairView::UpdatePoolRewards(std::function<CTokenAmount(CScript cons
 
         } else {
             if (!swapEvent && poolReward == 0 && rewards.balances.empty()) {
-                return true; // no events, skip to the next pool
+                continue; // no events, skip to the next pool
             }
 
             ForEachPoolShare([&] (DCT_ID const & currentId, CScript const & provider, uint32_t) {
@@ -572,18 +684,19 @@ CAmount CPoolPairView::UpdatePoolRewards(std::function<CTokenAmount(CScript cons
             poolKey.height++; // block commissions to next block
             WriteBy<ByPoolSwap>(poolKey, PoolSwapValue{false, swapValue->blockCommissionA, swapValue->blockCommissionB});
         }
-        return true;
-    });
+    }
     return totalDistributed;
 }
 
 Res CPoolPairView::SetShare(DCT_ID const & poolId, CScript const & provider, uint32_t height) {
     WriteBy<ByShare>(PoolShareKey{poolId, provider}, height);
+    WriteBy<ByOwnerShare>(OwnerShareKey{provider, poolId}, height);
     return Res::Ok();
 }
 
 Res CPoolPairView::DelShare(DCT_ID const & poolId, CScript const & provider) {
     EraseBy<ByShare>(PoolShareKey{poolId, provider});
+    EraseBy<ByOwnerShare>(OwnerShareKey{provider, poolId});
     return Res::Ok();
 }
 
@@ -591,6 +704,40 @@ boost::optional<uint32_t> CPoolPairView::GetShare(DCT_ID const & poolId, CScript
     return ReadBy<ByShare, uint32_t>(PoolShareKey{poolId, provider});
 }
 
+void CPoolPairView::ForEachOwnerShare(CScript const & owner, std::function<bool(DCT_ID const &, uint32_t)> callback, DCT_ID const & start) {
+    if (!HasOwnerShareIndex()) {
+        ForEachPoolId([&](DCT_ID const & poolId) {
+            auto height = GetShare(poolId, owner);
+            return !height || callback(poolId, *height);
+        }, start);
+        return;
+    }
+    ForEach<ByOwnerShare, OwnerShareKey, uint32_t>([&](OwnerShareKey const & key, uint32_t height) {
+        return key.owner == owner && callback(key.poolID, height);
+    }, OwnerShareKey{owner, start});
+}
+
+bool CPoolPairView::HasOwnerShareIndex() const {
+    return ExistsBy<ByOwnerShareIndex>(DCT_ID{});
+}
+
+bool CPoolPairView::BuildOwnerShareIndex() {
+    if (HasOwnerShareIndex()) {
+        return false;
+    }
+    // shares are collected first, the buffer is not written while it is iterated
+    std::vector<std::pair<OwnerShareKey, uint32_t>> shares;
+    ForEachPoolShare([&](DCT_ID const & poolId, CScript const & provider, uint32_t height) {
+        shares.emplace_back(OwnerShareKey{provider, poolId}, height);
+        return true;
+    });
+    for (const auto& share : shares) {
+        WriteBy<ByOwnerShare>(share.first, share.second);
+    }
+    WriteBy<ByOwnerShareIndex>(DCT_ID{}, '\0');
+    return true;
+}
+
 inline CAmount PoolRewardPerBlock(CAmount dailyReward, CAmount rewardPct) {
     return dailyReward / Params().GetConsensus().blocksPerDay() * rewardPct / COIN;
 }
@@ -622,13 +769,11 @@ bool CPoolPairView::HasPoolPair(DCT_ID const & poolId) const {
 }
 
 void CPoolPairView::ForEachPoolId(std::function<bool(const DCT_ID &)> callback, DCT_ID const & start) {
-    ForEach<ByID, DCT_ID, CPoolPair>([&callback](const DCT_ID & poolId, CLazySerialize<CPoolPair>) {
-        return callback(poolId);
-    }, start);
+    ForEachKey<ByID>(callback, start);
 }
 
 void CPoolPairView::ForEachPoolPair(std::function<bool(const DCT_ID &, CPoolPair)> callback, DCT_ID const & start) {
-    ForEach<ByID, DCT_ID, CPoolPair>([&](const DCT_ID & poolId, CLazySerialize<CPoolPair>) {
+    ForEachKey<ByID, DCT_ID>([&](const DCT_ID & poolId) {
         return callback(poolId, *GetPoolPair(poolId));
     }, start);
 }
@@ -638,3 +783,126 @@ void CPoolPairView::ForEachPoolShare(std::function<bool (DCT_ID const &, CScript
         return callback(poolShareKey.poolID, poolShareKey.owner, height);
     }, startKey);
 }
+
+CPoolSwapGraph::CPoolSwapGraph(CPoolPairView & view, int height) : height(height) {
+    view.ForEachPoolPair([&](DCT_ID const & poolId, CPoolPair pool) {
+        // only swap related fields are kept
+        pool.ownerAddress.clear();
+        pool.rewards.balances.clear();
+        tokenPools.emplace(pool.idTokenA, poolId);
+        tokenPools.emplace(pool.idTokenB, poolId);
+        pools.emplace(poolId, std::move(pool));
+        return true;
+    });
+}
+
+static Mutex cs_poolSwapGraph;
+static uint256 poolSwapGraphBlock GUARDED_BY(cs_poolSwapGraph);
+static std::shared_ptr<const CPoolSwapGraph> poolSwapGraph GUARDED_BY(cs_poolSwapGraph);
+
+std::shared_ptr<const CPoolSwapGraph> GetPoolSwapGraph(uint256 const & blockHash, CPoolPairView & view, int height) {
+    LOCK(cs_poolSwapGraph);
+    if (!poolSwapGraph || poolSwapGraphBlock != blockHash) {
+        poolSwapGraph = std::make_shared<const CPoolSwapGraph>(view, height);
+        poolSwapGraphBlock = blockHash;
+    }
+    return poolSwapGraph;
+}
+
+void ResetPoolSwapGraph() {
+    LOCK(cs_poolSwapGraph);
+    poolSwapGraph.reset();
+    poolSwapGraphBlock.SetNull();
+}
+
+boost::optional<DCT_ID> CPoolSwapGraph::GetPoolId(DCT_ID const & tokenA, DCT_ID const & tokenB) const {
+    auto range = tokenPools.equal_range(tokenA);
+    for (auto it = range.first; it != range.second; ++it) {
+        const auto& pool = pools.at(it->second);
+        if (pool.idTokenA == tokenB || pool.idTokenB == tokenB) {
+            return it->second;
+        }
+    }
+    return {};
+}
+
+ResVal<CTokenAmount> CPoolSwapGraph::SwapPool(CTokenAmount in, DCT_ID poolId, PoolPrice const & maxPrice) const {
+    auto it = pools.find(poolId);
+    if (it == pools.end()) {
+        return Res::Err("Pool %s does not exist", poolId.ToString());
+    }
+    auto pool = it->second;
+    CTokenAmount out{};
+    auto res = pool.Swap(in, maxPrice, [&](CTokenAmount const & amount) {
+        out = amount;
+        return Res::Ok();
+    }, height);
+    if (!res) {
+        return res;
+    }
+    return {out, Res::Ok()};
+}
+
+ResVal<CTokenAmount> CPoolSwapGraph::Swap(CTokenAmount in, std::vector<DCT_ID> const & path) const {
+    if (path.empty()) {
+        return Res::Err("Empty swap path");
+    }
+    // a pool can be met twice, its reserves are changed by the first swap
+    std::map<DCT_ID, CPoolPair> swapped;
+    for (const auto& poolId : path) {
+        auto it = swapped.find(poolId);
+        if (it == swapped.end()) {
+            auto pool = pools.find(poolId);
+            if (pool == pools.end()) {
+                return Res::Err("Pool %s does not exist", poolId.ToString());
+            }
+            it = swapped.emplace(poolId, pool->second).first;
+        }
+        auto res = it->second.Swap(in, PoolPrice{INT64_MAX, INT64_MAX}, [&](CTokenAmount const & amount) {
+            in = amount;
+            return Res::Ok();
+        }, height);
+        if (!res) {
+            return Res::Err("Pool %s: %s", poolId.ToString(), res.msg);
+        }
+    }
+    return {in, Res::Ok()};
+}
+
+ResVal<CPoolSwapPath> CPoolSwapGraph::FindBestPath(CTokenAmount in, DCT_ID tokenTo, size_t maxHops) const {
+    if (in.nTokenId == tokenTo) {
+        return Res::Err("Tokens should be different");
+    }
+    boost::optional<CPoolSwapPath> best;
+    std::vector<DCT_ID> path;
+    std::set<DCT_ID> tokens{in.nTokenId};
+
+    // pools of a simple path are different, so prefix outputs are reused by longer paths
+    std::function<void(CTokenAmount const &)> search = [&](CTokenAmount const & amount) {
+        auto range = tokenPools.equal_range(amount.nTokenId);
+        for (auto it = range.first; it != range.second; ++it) {
+            auto out = SwapPool(amount, it->second);
+            if (!out || tokens.count(out.val->nTokenId)) {
+                continue;
+            }
+            path.push_back(it->second);
+            if (out.val->nTokenId == tokenTo) {
+                if (!best || out.val->nValue > best->amount.nValue
+                || (out.val->nValue == best->amount.nValue && path.size() < best->pools.size())) {
+                    best = CPoolSwapPath{path, *out.val};
+                }
+            } else if (path.size() < maxHops) {
+                tokens.insert(out.val->nTokenId);
+                search(*out.val);
+                tokens.erase(out.val->nTokenId);
+            }
+            path.pop_back();
+        }
+    };
+    search(in);
+
+    if (!best) {
+        return Res::Err("No swap path from %s to %s within %d pools", in.nTokenId.ToString(), tokenTo.ToString(), maxHops);
+    }
+    return {*best, Res::Ok()};
+}
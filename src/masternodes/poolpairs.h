@@ -156,6 +156,19 @@ struct PoolShareKey {
     }
 };
 
+struct OwnerShareKey {
+    CScript owner;
+    DCT_ID poolID;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(owner);
+        READWRITE(WrapBigEndian(poolID.v));
+    }
+};
+
 struct PoolHeightKey {
     DCT_ID poolID;
     uint32_t height;
@@ -191,6 +204,25 @@ inline std::string RewardToString(RewardType type)
     return "Unknown";
 }
 
+// Provider's share of a pool reward
+CAmount liquidityReward(CAmount reward, CAmount liquidity, CAmount totalLiquidity);
+
+// Shares of a pool reward for many providers at once, bit-identical to the calculation per provider.
+// Uses 128 bits integer maths instead of arith_uint256 where the compiler provides it
+void CalculateLiquidityRewards(CAmount reward, CAmount totalLiquidity, CAmount const * liquidity, CAmount * rewards, size_t count, bool newCalculation = true);
+
+// State of a pool over heights [begin, end), owner's reward is the same at every height of it
+struct PoolRewardsRange {
+    uint32_t begin;
+    uint32_t end;
+    CAmount totalLiquidity;
+    CAmount poolReward;
+    bool swapEvent = false;
+    CAmount blockCommissionA = 0;
+    CAmount blockCommissionB = 0;
+    CBalances customRewards;
+};
+
 class CPoolPairView : public virtual CStorageView
 {
 public:
@@ -208,8 +240,24 @@ public:
     Res DelShare(DCT_ID const & poolId, CScript const & provider);
 
     boost::optional<uint32_t> GetShare(DCT_ID const & poolId, CScript const & provider);
+    // visits pools of the owner only, in pool id order, every pool is probed until the owner index is built
+    void ForEachOwnerShare(CScript const & owner, std::function<bool(DCT_ID const &, uint32_t)> callback, DCT_ID const & start = DCT_ID{0});
 
+    // onReward is called for every height of [begin, end) with owner's reward
     void CalculatePoolRewards(DCT_ID const & poolId, std::function<CAmount()> onLiquidity, uint32_t begin, uint32_t end, std::function<void(RewardType, CTokenAmount, uint32_t)> onReward);
+    // onRewards is called for ranges of heights with the same pool state, the amount is reward per height,
+    // it takes O(pool changes) instead of O(heights)
+    void CalculatePoolRewardRanges(DCT_ID const & poolId, std::function<CAmount()> onLiquidity, uint32_t begin, uint32_t end, std::function<void(RewardType, CTokenAmount, uint32_t, uint32_t)> onRewards);
+    // walks pool state once, ranges are shared by owners settled in batch
+    void ForEachPoolRewardsRange(DCT_ID const & poolId, uint32_t begin, uint32_t end, std::function<bool(PoolRewardsRange const &)> callback);
+    // onReward is called with owner's reward per height of the range
+    static void CalculateRangeRewards(ByPairKey const & tokenIds, PoolRewardsRange const & range, CAmount liquidity, std::function<void(RewardType, CTokenAmount)> onReward);
+    // the same for many owners, onRewards is called when rewards[i] are filled with the token rewards of liquidity[i]
+    static void CalculateRangeRewards(ByPairKey const & tokenIds, PoolRewardsRange const & range, CAmount const * liquidity, size_t count, CAmount * rewards, std::function<void(RewardType, DCT_ID)> onRewards);
+
+    // builds owner index of shares written before the index existed, once per database
+    bool BuildOwnerShareIndex();
+    bool HasOwnerShareIndex() const;
 
     Res SetDailyReward(uint32_t height, CAmount reward);
     Res SetRewardPct(DCT_ID const & poolId, uint32_t height, CAmount rewardPct);
@@ -217,10 +265,16 @@ public:
 
     CAmount UpdatePoolRewards(std::function<CTokenAmount(CScript const &, DCT_ID)> onGetBalance, std::function<Res(CScript const &, CScript const &, CTokenAmount)> onTransfer, int nHeight = 0);
 
+    // settlement reports owner's reward per height over [begin, end) to the view recording rewards history
+    virtual bool IsRecordingRewards() const { return false; }
+    virtual void OnOwnerRewards(CScript const & owner, DCT_ID const & poolId, RewardType type, CTokenAmount amount, uint32_t begin, uint32_t end) {}
+
     // tags
     struct ByID { static const unsigned char prefix; }; // lsTokenID -> СPoolPair
     struct ByPair { static const unsigned char prefix; }; // tokenA+tokenB -> lsTokenID
     struct ByShare { static const unsigned char prefix; }; // lsTokenID+accountID -> {}
+    struct ByOwnerShare { static const unsigned char prefix; }; // accountID+lsTokenID -> height, reverse index of ByShare
+    struct ByOwnerShareIndex { static const unsigned char prefix; }; // marker of complete ByOwnerShare
     struct ByIDPair { static const unsigned char prefix; }; // lsTokenID -> tokenA+tokenB
     struct ByPoolSwap { static const unsigned char prefix; };
     struct ByReserves { static const unsigned char prefix; };
@@ -256,6 +310,41 @@ struct CLiquidityMessage {
     }
 };
 
+struct CPoolSwapPath {
+    std::vector<DCT_ID> pools;
+    CTokenAmount amount;
+};
+
+// Reserves of all pools loaded at once, swaps over chains of pools are simulated
+// on copies of them with consensus arithmetic, so the graph itself is immutable
+class CPoolSwapGraph {
+public:
+    static const size_t DEFAULT_MAX_HOPS = 3;
+
+    CPoolSwapGraph(CPoolPairView & view, int height);
+
+    boost::optional<DCT_ID> GetPoolId(DCT_ID const & tokenA, DCT_ID const & tokenB) const;
+    // swap in a single pool, it fails like poolswap if the price is higher than maxPrice
+    ResVal<CTokenAmount> SwapPool(CTokenAmount in, DCT_ID poolId, PoolPrice const & maxPrice = {INT64_MAX, INT64_MAX}) const;
+    // swaps through the pools in order, output of a pool is input of the next one
+    ResVal<CTokenAmount> Swap(CTokenAmount in, std::vector<DCT_ID> const & path) const;
+    // path with the greatest output over at most maxHops pools, the shortest one of equal outputs
+    ResVal<CPoolSwapPath> FindBestPath(CTokenAmount in, DCT_ID tokenTo, size_t maxHops = DEFAULT_MAX_HOPS) const;
+
+    int GetHeight() const { return height; }
+
+private:
+    const int height;
+    std::map<DCT_ID, CPoolPair> pools;
+    std::multimap<DCT_ID, DCT_ID> tokenPools; // token -> pools it's traded in
+};
+
+/** Graph of the pools after the block, it's built once per block and shared by callers.
+ *  It holds no storage, view is read only when the block is changed */
+std::shared_ptr<const CPoolSwapGraph> GetPoolSwapGraph(uint256 const & blockHash, CPoolPairView & view, int height);
+/** Drops the shared graph, it's called on shutdown */
+void ResetPoolSwapGraph();
+
 struct CRemoveLiquidityMessage {
     CScript from;
     CTokenAmount amount;
@@ -0,0 +1,116 @@
+// Copyright (c) DeFi Blockchain Developers
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+
+#include <masternodes/poolproviders.h>
+#include <masternodes/masternodes.h>
+
+void CPoolProvidersRegistry::PoolProviders::Set(CScript const & provider, CAmount amount)
+{
+    auto it = liquidity.find(provider);
+    if (it != liquidity.end()) {
+        if (it->second == amount) {
+            return;
+        }
+        byLiquidity.erase({it->second, provider});
+        it->second = amount;
+    } else {
+        liquidity.emplace(provider, amount);
+    }
+    byLiquidity.emplace(amount, provider);
+}
+
+void CPoolProvidersRegistry::PoolProviders::Erase(CScript const & provider)
+{
+    auto it = liquidity.find(provider);
+    if (it != liquidity.end()) {
+        byLiquidity.erase({it->second, provider});
+        liquidity.erase(it);
+    }
+}
+
+void CPoolProvidersRegistry::Load(CCustomCSView & view)
+{
+    LOCK(cs);
+    if (loaded) {
+        return;
+    }
+    pools.clear();
+    view.ForEachPoolShare([&](DCT_ID const & poolId, CScript const & provider, uint32_t) {
+        pools[poolId].Set(provider, view.GetBalance(provider, poolId).nValue);
+        return true;
+    });
+    loaded = true;
+}
+
+bool CPoolProvidersRegistry::IsLoaded() const
+{
+    LOCK(cs);
+    return loaded;
+}
+
+void CPoolProvidersRegistry::ApplyChanges(CCustomCSView & view)
+{
+    LOCK(cs);
+    if (!loaded) {
+        return;
+    }
+    auto& changes = view.GetStorage().GetRaw();
+
+    // shares are changed before balances, new providers are counted by their balances below
+    const TBytes sharesPrefix{CPoolPairView::ByShare::prefix};
+    for (auto it = changes.lower_bound(sharesPrefix); it != changes.end() && StartsWith(it->first, sharesPrefix); ++it) {
+        std::pair<uint8_t, PoolShareKey> key;
+        if (!BytesToDbType(it->first, key)) {
+            continue;
+        }
+        auto& poolId = key.second.poolID;
+        auto& provider = key.second.owner;
+        if (it->second) {
+            pools[poolId].Set(provider, view.GetBalance(provider, poolId).nValue);
+        } else {
+            auto pool = pools.find(poolId);
+            if (pool != pools.end()) {
+                pool->second.Erase(provider);
+            }
+        }
+    }
+
+    const TBytes balancesPrefix{CAccountsView::ByBalanceKey::prefix};
+    for (auto it = changes.lower_bound(balancesPrefix); it != changes.end() && StartsWith(it->first, balancesPrefix); ++it) {
+        std::pair<uint8_t, BalanceKey> key;
+        if (!BytesToDbType(it->first, key)) {
+            continue;
+        }
+        // LP token id is the pool id, only balances of providers are followed
+        auto pool = pools.find(key.second.tokenID);
+        if (pool == pools.end() || !pool->second.liquidity.count(key.second.owner)) {
+            continue;
+        }
+        pool->second.Set(key.second.owner, view.GetBalance(key.second.owner, key.second.tokenID).nValue);
+    }
+}
+
+size_t CPoolProvidersRegistry::GetProvidersCount(DCT_ID const & poolId) const
+{
+    LOCK(cs);
+    auto pool = pools.find(poolId);
+    return pool != pools.end() ? pool->second.liquidity.size() : 0;
+}
+
+std::vector<std::pair<CScript, CAmount>> CPoolProvidersRegistry::GetTopProviders(DCT_ID const & poolId, size_t count) const
+{
+    LOCK(cs);
+    std::vector<std::pair<CScript, CAmount>> result;
+    auto pool = pools.find(poolId);
+    if (pool == pools.end()) {
+        return result;
+    }
+    auto& byLiquidity = pool->second.byLiquidity;
+    for (auto it = byLiquidity.rbegin(); it != byLiquidity.rend() && result.size() < count; ++it) {
+        result.emplace_back(it->second, it->first);
+    }
+    return result;
+}
+
+std::unique_ptr<CPoolProvidersRegistry> ppoolProviders;
@@ -0,0 +1,54 @@
+// Copyright (c) DeFi Blockchain Developers
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DEFI_MASTERNODES_POOLPROVIDERS_H
+#define DEFI_MASTERNODES_POOLPROVIDERS_H
+
+#include <amount.h>
+#include <masternodes/balances.h>
+#include <script/script.h>
+#include <sync.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+class CCustomCSView;
+
+// Liquidity providers of every pool kept in memory, it follows the chain tip.
+// It isn't stored, one scan of pool shares at startup is cheaper than a table
+// maintained by every block
+class CPoolProvidersRegistry
+{
+public:
+    // builds the registry by scan of pool shares, further changes are applied by blocks
+    void Load(CCustomCSView & view);
+    bool IsLoaded() const;
+
+    // it should be called with block's view before its changes are flushed to the tip view,
+    // shares and LP token balances changed by the block are taken from the view
+    void ApplyChanges(CCustomCSView & view);
+
+    size_t GetProvidersCount(DCT_ID const & poolId) const;
+    // providers with the largest liquidity first
+    std::vector<std::pair<CScript, CAmount>> GetTopProviders(DCT_ID const & poolId, size_t count) const;
+
+private:
+    struct PoolProviders {
+        std::map<CScript, CAmount> liquidity;
+        std::set<std::pair<CAmount, CScript>> byLiquidity;
+
+        void Set(CScript const & provider, CAmount amount);
+        void Erase(CScript const & provider);
+    };
+
+    mutable CCriticalSection cs;
+    bool loaded = false;
+    std::map<DCT_ID, PoolProviders> pools;
+};
+
+extern std::unique_ptr<CPoolProvidersRegistry> ppoolProviders;
+
+#endif //DEFI_MASTERNODES_POOLPROVIDERS_H
@@ -1,6 +1,10 @@
 #include <masternodes/accountshistory.h>
 #include <masternodes/mn_rpc.h>
 
+#include <util/parallel.h>
+
+#include <queue>
+
 std::string tokenAmountString(CTokenAmount const& amount) {
     const auto token = pcustomcsview->GetToken(amount.nTokenId);
     const auto valueString = ValueFromAmount(amount.nValue).getValStr();
@@ -45,9 +49,58 @@ UniValue accountToJSON(CScript const& owner, CTokenAmount const& amount, bool ve
     return obj;
 }
 
+// opaque position in the history, the serialized key keeps the database order
+static std::string accountHistoryKeyToString(AccountHistoryKey const & key) {
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << key;
+    return HexStr(ss.begin(), ss.end());
+}
+
+static AccountHistoryKey decodeAccountHistoryKey(std::string const & str) {
+    if (!IsHex(str)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "(" + str + ") doesn't represent a correct hex:\n");
+    }
+    AccountHistoryKey key;
+    CDataStream ss(ParseHex(str), SER_DISK, CLIENT_VERSION);
+    bool decoded = true;
+    try {
+        ss >> key;
+    } catch (const std::ios_base::failure&) {
+        decoded = false;
+    }
+    if (!decoded || !ss.empty()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "(" + str + ") doesn't represent a correct history key");
+    }
+    return key;
+}
+
+// the next key of the owner in the database order, heights and txns are descending.
+// False if the key is the last possible one
+static bool nextAccountHistoryKey(AccountHistoryKey & key) {
+    if (key.txn != 0) {
+        --key.txn;
+    } else if (key.blockHeight != 0) {
+        --key.blockHeight;
+        key.txn = std::numeric_limits<uint32_t>::max();
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// checks the start key against the scanned heights, moves it past the record unless it's included.
+// False if no record follows the start
+static bool prepareStartKey(AccountHistoryKey & start, bool includingStart, uint32_t maxBlockHeight) {
+    if (start.blockHeight > maxBlockHeight) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "start key height is above maxBlockHeight");
+    }
+    return includingStart || nextAccountHistoryKey(start);
+}
+
 UniValue accounthistoryToJSON(AccountHistoryKey const & key, AccountHistoryValue const & value) {
     UniValue obj(UniValue::VOBJ);
 
+    obj.pushKV("key", accountHistoryKeyToString(key));
     obj.pushKV("owner", ScriptToString(key.owner));
     obj.pushKV("blockHeight", (uint64_t) key.blockHeight);
     if (auto block = ::ChainActive()[key.blockHeight]) {
@@ -97,17 +150,19 @@ UniValue outputEntryToJSON(COutputEntry const & entry, CBlockIndex const * index
     return obj;
 }
 
-static void onPoolRewards(CCustomCSView & view, CScript const & owner, uint32_t begin, uint32_t end, std::function<void(uint32_t, DCT_ID, RewardType, CTokenAmount)> onReward) {
+static void replayPoolRewards(CCustomCSView & view, CScript const & owner, uint32_t begin, uint32_t end, std::function<void(uint32_t, DCT_ID, RewardType, CTokenAmount)> onReward) {
+    if (begin >= end) {
+        return;
+    }
     CCustomCSView mnview(view);
-    view.ForEachPoolId([&] (DCT_ID const & poolId) {
-        auto height = view.GetShare(poolId, owner);
-        if (!height || *height >= end) {
-            return true; // no share or target height is before a pool share' one
+    view.ForEachOwnerShare(owner, [&] (DCT_ID const & poolId, uint32_t height) {
+        if (height >= end) {
+            return true; // target height is before a pool share' one
         }
         auto onLiquidity = [&]() -> CAmount {
             return mnview.GetBalance(owner, poolId).nValue;
         };
-        auto beginHeight = std::max(*height, begin);
+        auto beginHeight = std::max(height, begin);
         view.CalculatePoolRewards(poolId, onLiquidity, beginHeight, end,
             [&](RewardType type, CTokenAmount amount, uint32_t height) {
                 onReward(height, poolId, type, amount);
@@ -118,6 +173,35 @@ static void onPoolRewards(CCustomCSView & view, CScript const & owner, uint32_t
     });
 }
 
+static void onPoolRewards(CCustomCSView & view, CScript const & owner, uint32_t begin, uint32_t end, std::function<void(uint32_t, DCT_ID, RewardType, CTokenAmount)> onReward) {
+    if (!paccountHistoryDB->HasRewardHistory()) {
+        replayPoolRewards(view, owner, begin, end, onReward);
+        return;
+    }
+    // rewards paid every block before Eunos aren't recorded
+    const auto eunosHeight = uint32_t(Params().GetConsensus().EunosHeight);
+    if (begin < eunosHeight) {
+        replayPoolRewards(view, owner, begin, std::min(end, eunosHeight), onReward);
+        begin = eunosHeight;
+    }
+    // settled rewards are read from history, heights since the last settlement are calculated
+    auto settledHeight = std::min(view.GetBalancesHeight(owner), end);
+    if (begin < settledHeight) {
+        paccountHistoryDB->ForEachRewardHistory(owner, [&](uint32_t height, DCT_ID const & poolId, CLazySerialize<RewardHistoryValue> value) {
+            if (height <= begin) {
+                return false; // the rest is below begin
+            }
+            for (const auto& range : value.get()) {
+                for (auto height = std::max(range.begin, begin); height < std::min(range.end, settledHeight); ++height) {
+                    onReward(height, poolId, RewardType(range.type), range.amount);
+                }
+            }
+            return true;
+        }, settledHeight);
+    }
+    replayPoolRewards(view, owner, std::max(begin, settledHeight), end, onReward);
+}
+
 static void searchInWallet(CWallet const * pwallet,
                            CScript const & account,
                            isminetype filter,
@@ -302,9 +386,10 @@ UniValue listaccounts(const JSONRPCRequest& request) {
 
     UniValue ret(UniValue::VARR);
 
-    LOCK(cs_main);
-    CCustomCSView mnview(*pcustomcsview);
-    auto targetHeight = chainHeight(*pwallet->chain().lock()) + 1;
+    // scan doesn't block block connection
+    auto snapshot = GetCustomCSSnapshot();
+    CCustomCSView mnview(*snapshot.storage);
+    auto targetHeight = snapshot.height + 1;
 
     mnview.ForEachAccount([&](CScript const & account) {
 
@@ -494,15 +579,20 @@ UniValue gettokenbalances(const JSONRPCRequest& request) {
     CCustomCSView mnview(*pcustomcsview);
     auto targetHeight = chainHeight(*pwallet->chain().lock()) + 1;
 
+    std::vector<CScript> accounts;
     mnview.ForEachAccount([&](CScript const & account) {
         if (IsMineCached(*pwallet, account) == ISMINE_SPENDABLE) {
-            mnview.CalculateOwnerRewards(account, targetHeight);
-            mnview.ForEachBalance([&](CScript const & owner, CTokenAmount balance) {
-                return account == owner && totalBalances.Add(balance);
-            }, {account, DCT_ID{}});
+            accounts.push_back(account);
         }
         return true;
     });
+    // wallet owners are settled at once
+    mnview.CalculateOwnerRewards(accounts, targetHeight);
+    for (const auto& account : accounts) {
+        mnview.ForEachBalance([&](CScript const & owner, CTokenAmount balance) {
+            return account == owner && totalBalances.Add(balance);
+        }, {account, DCT_ID{}});
+    }
     auto it = totalBalances.balances.lower_bound(start);
     for (int i = 0; it != totalBalances.balances.end() && i < limit; it++, i++) {
         CTokenAmount bal = CTokenAmount{(*it).first, (*it).second};
@@ -902,6 +992,26 @@ public:
     }
 };
 
+// filtered history is walked through secondary indexes when they are built
+static void ForEachFilteredAccountHistory(CAccountsHistoryView::AccountHistoryCallback callback, AccountHistoryKey const & start, std::string const & tokenFilter, CustomTxType txType, uint256 const & txid = {}) {
+    if (paccountHistoryDB->HasSecondaryIndexes()) {
+        DCT_ID tokenId;
+        if (!txid.IsNull()) {
+            paccountHistoryDB->ForEachAccountHistoryByTxid(txid, callback, start);
+            return;
+        }
+        if (!tokenFilter.empty() && pcustomcsview->GetTokenGuessId(tokenFilter, tokenId)) {
+            paccountHistoryDB->ForEachAccountHistoryByToken(tokenId, callback, start);
+            return;
+        }
+        if (txType != CustomTxType::None) {
+            paccountHistoryDB->ForEachAccountHistoryByCategory(uint8_t(txType), callback, start);
+            return;
+        }
+    }
+    paccountHistoryDB->ForEachAccountHistory(callback, start);
+}
+
 UniValue listaccounthistory(const JSONRPCRequest& request) {
     CWallet* const pwallet = GetWallet(request);
     RPCHelpMan{"listaccounthistory",
@@ -921,8 +1031,15 @@ UniValue listaccounthistory(const JSONRPCRequest& request) {
                                   "Filter by token"},
                                  {"txtype", RPCArg::Type::STR, RPCArg::Optional::OMITTED,
                                   "Filter by transaction type, supported letter from {CustomTxType}"},
+                                 {"txid", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED,
+                                  "Filter by transaction id"},
                                  {"limit", RPCArg::Type::NUM, RPCArg::Optional::OMITTED,
                                   "Maximum number of records to return, 100 by default"},
+                                 {"start", RPCArg::Type::STR, RPCArg::Optional::OMITTED,
+                                  "Optional key of a single owner's record to continue from, in the history order. "
+                                  "Typically it's set to the key of the last record from previous request."},
+                                 {"including_start", RPCArg::Type::BOOL, RPCArg::Optional::OMITTED,
+                                  "If true, then iterate including starting position. False by default"},
                             },
                         },
                },
@@ -950,6 +1067,9 @@ UniValue listaccounthistory(const JSONRPCRequest& request) {
     std::string tokenFilter;
     uint32_t limit = 100;
     auto txType = CustomTxType::None;
+    uint256 txidFilter;
+    boost::optional<AccountHistoryKey> start;
+    bool includingStart = false;
 
     if (request.params.size() > 1) {
         UniValue optionsObj = request.params[1].get_obj();
@@ -960,7 +1080,10 @@ UniValue listaccounthistory(const JSONRPCRequest& request) {
                 {"no_rewards", UniValueType(UniValue::VBOOL)},
                 {"token", UniValueType(UniValue::VSTR)},
                 {"txtype", UniValueType(UniValue::VSTR)},
+                {"txid", UniValueType(UniValue::VSTR)},
                 {"limit", UniValueType(UniValue::VNUM)},
+                {"start", UniValueType(UniValue::VSTR)},
+                {"including_start", UniValueType(UniValue::VBOOL)},
             }, true, true);
 
         if (!optionsObj["maxBlockHeight"].isNull()) {
@@ -984,12 +1107,21 @@ UniValue listaccounthistory(const JSONRPCRequest& request) {
                 txType = CustomTxCodeToType(str[0]);
             }
         }
+        if (!optionsObj["txid"].isNull()) {
+            txidFilter = ParseHashV(optionsObj["txid"], "txid");
+        }
         if (!optionsObj["limit"].isNull()) {
             limit = (uint32_t) optionsObj["limit"].get_int64();
         }
         if (limit == 0) {
             limit = std::numeric_limits<decltype(limit)>::max();
         }
+        if (!optionsObj["start"].isNull()) {
+            start = decodeAccountHistoryKey(optionsObj["start"].get_str());
+        }
+        if (!optionsObj["including_start"].isNull()) {
+            includingStart = optionsObj["including_start"].getBool();
+        }
     }
 
     pwallet->BlockUntilSyncedToCurrentChain();
@@ -1017,13 +1149,21 @@ UniValue listaccounthistory(const JSONRPCRequest& request) {
         };
     }
 
+    // records of many owners are replied in height order, so a key doesn't mark the page end
+    if (start && (accounts == "mine" || accounts == "all" || start->owner != account)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "start is supported for history of the single owner of the key");
+    }
+    if (start && !prepareStartKey(*start, includingStart, maxBlockHeight)) {
+        return UniValue(UniValue::VARR);
+    }
+
     const auto startBlock = maxBlockHeight - depth;
     auto shouldSkipBlock = [startBlock, maxBlockHeight](uint32_t blockHeight) {
         return startBlock > blockHeight || blockHeight > maxBlockHeight;
     };
 
-    std::set<uint256> txs;
-    const bool shouldSearchInWallet = (tokenFilter.empty() || tokenFilter == "DFI") && CustomTxType::None == txType;
+    // wallet outputs have no history keys, they are listed on the first page only
+    const bool shouldSearchInWallet = (tokenFilter.empty() || tokenFilter == "DFI") && CustomTxType::None == txType && txidFilter.IsNull() && !start;
 
     auto hasToken = [&tokenFilter](TAmounts const & diffs) {
         for (auto const & diff : diffs) {
@@ -1036,75 +1176,189 @@ UniValue listaccounthistory(const JSONRPCRequest& request) {
         return false;
     };
 
-    LOCK(cs_main);
-    CCustomCSView view(*pcustomcsview);
-    CCoinsViewCache coins(&::ChainstateActive().CoinsTip());
-    std::map<uint32_t, UniValue, std::greater<uint32_t>> ret;
+    // raw records, JSON is built by the calling thread
+    struct RewardRow {
+        DCT_ID poolId;
+        RewardType type;
+        CTokenAmount amount;
+    };
+    struct HistoryRow {
+        AccountHistoryKey key; // owner and height of a reward
+        boost::variant<AccountHistoryValue, RewardRow> value;
+    };
+    auto rowToJSON = [](HistoryRow const & row) {
+        if (auto value = boost::get<AccountHistoryValue>(&row.value)) {
+            return accounthistoryToJSON(row.key, *value);
+        }
+        const auto& reward = boost::get<RewardRow>(row.value);
+        return rewardhistoryToJSON(row.key.owner, row.key.blockHeight, reward.poolId, reward.type, reward.amount);
+    };
 
-    auto count = limit;
-    auto lastHeight = maxBlockHeight;
+    // history of one owner or of the whole scan, rows are grouped by height like the reply
+    struct HistoryPart {
+        std::map<uint32_t, std::vector<HistoryRow>, std::greater<uint32_t>> rows;
+        std::set<uint256> txs;
+    };
 
-    auto shouldContinueToNextAccountHistory = [&](AccountHistoryKey const & key, CLazySerialize<AccountHistoryValue> valueLazy) -> bool {
-        if (!isMatchOwner(key.owner)) {
-            return false;
-        }
+    // Owners' parts can be scanned by worker threads. A scan reads pcustomcsview and paccountHistoryDB only,
+    // they aren't written while the calling thread holds cs_main. The wallet and the chain are read by the caller
+    auto scanHistory = [&](HistoryPart & part, AccountHistoryKey const & startKey, std::function<bool(CScript const &)> const & isMatchOwner) {
+        CCustomCSView view(*pcustomcsview);
+        auto count = limit;
+        // rewards above the start are on the previous page
+        auto lastHeight = std::min(maxBlockHeight, startKey.blockHeight);
 
-        if (shouldSkipBlock(key.blockHeight)) {
-            return true;
-        }
+        auto shouldContinueToNextAccountHistory = [&](AccountHistoryKey const & key, CLazySerialize<AccountHistoryValue> valueLazy) -> bool {
+            if (!isMatchOwner(key.owner)) {
+                return false;
+            }
 
-        if (isMine && !(IsMineCached(*pwallet, key.owner) & filter)) {
-            return true;
-        }
+            if (shouldSkipBlock(key.blockHeight)) {
+                return true;
+            }
 
-        const auto & value = valueLazy.get();
+            const auto & value = valueLazy.get();
 
-        if (CustomTxType::None != txType && value.category != uint8_t(txType)) {
-            return true;
-        }
+            if (CustomTxType::None != txType && value.category != uint8_t(txType)) {
+                return true;
+            }
 
-        if(!tokenFilter.empty() && !hasToken(value.diff)) {
-            return true;
-        }
+            if (!txidFilter.IsNull() && value.txid != txidFilter) {
+                return true;
+            }
 
-        std::unique_ptr<CScopeTxReverter> reverter;
-        if (!noRewards) {
-            reverter = MakeUnique<CScopeTxReverter>(view, value.txid, key.blockHeight);
-        }
+            if(!tokenFilter.empty() && !hasToken(value.diff)) {
+                return true;
+            }
 
-        auto& array = ret.emplace(key.blockHeight, UniValue::VARR).first->second;
-        array.push_back(accounthistoryToJSON(key, value));
-        if (shouldSearchInWallet) {
-            txs.insert(value.txid);
-        }
+            std::unique_ptr<CScopeTxReverter> reverter;
+            if (!noRewards) {
+                reverter = MakeUnique<CScopeTxReverter>(view, value.txid, key.blockHeight);
+            }
 
-        --count;
+            part.rows[key.blockHeight].push_back({key, value});
+            if (shouldSearchInWallet) {
+                part.txs.insert(value.txid);
+            }
 
-        if (!noRewards && count) {
-            onPoolRewards(view, key.owner, key.blockHeight, lastHeight,
-                [&](int32_t height, DCT_ID poolId, RewardType type, CTokenAmount amount) {
-                    auto& array = ret.emplace(height, UniValue::VARR).first->second;
-                    array.push_back(rewardhistoryToJSON(key.owner, height, poolId, type, amount));
-                    count ? --count : 0;
-                }
-            );
-            lastHeight = key.blockHeight;
+            --count;
+
+            if (!noRewards && count) {
+                onPoolRewards(view, key.owner, key.blockHeight, lastHeight,
+                    [&](int32_t height, DCT_ID poolId, RewardType type, CTokenAmount amount) {
+                        part.rows[height].push_back({{key.owner, uint32_t(height), 0}, RewardRow{poolId, type, amount}});
+                        count ? --count : 0;
+                    }
+                );
+                lastHeight = key.blockHeight;
+            }
+
+            return count != 0;
+        };
+
+        if (!noRewards) {
+            // revert previous tx to restore account balances to maxBlockHeight
+            auto it = paccountHistoryDB->LowerBound<CAccountsHistoryView::ByAccountHistoryKey>(startKey);
+            if (it.Valid() && (it.Prev(), it.Valid()) && it.Key().owner == startKey.owner) {
+                view.OnUndoTx(it.Value().as<AccountHistoryValue>().txid, it.Key().blockHeight);
+            }
         }
 
-        return count != 0;
+        ForEachFilteredAccountHistory(shouldContinueToNextAccountHistory, startKey, tokenFilter, txType, txidFilter);
     };
 
-    AccountHistoryKey startKey{account, maxBlockHeight, std::numeric_limits<uint32_t>::max()};
+    LOCK(cs_main);
+    CCoinsViewCache coins(&::ChainstateActive().CoinsTip());
+    std::map<uint32_t, UniValue, std::greater<uint32_t>> ret;
+    std::set<uint256> txs;
+
+    auto count = limit;
 
-    if (!noRewards) {
-        // revert previous tx to restore account balances to maxBlockHeight
-        auto it = paccountHistoryDB->LowerBound<CAccountsHistoryView::ByAccountHistoryKey>(startKey);
-        if (it.Valid() && (it.Prev(), it.Valid())) {
-            view.OnUndoTx(it.Value().as<AccountHistoryValue>().txid, it.Key().blockHeight);
+    if (isMine && account.empty()) {
+        // wallet owners are found by a seek per owner, their ranges are scanned in parallel
+        std::vector<CScript> owners;
+        auto it = paccountHistoryDB->LowerBound<CAccountsHistoryView::ByAccountHistoryKey>(AccountHistoryKey{});
+        while (it.Valid()) {
+            const auto owner = it.Key().owner;
+            if (IsMineCached(*pwallet, owner) & filter) {
+                owners.push_back(owner);
+            }
+            it.Seek(AccountHistoryKey{owner, 0, 0}); // the last possible key of the owner
+            if (it.Valid() && it.Key().owner == owner) {
+                it.Next();
+            }
         }
-    }
 
-    paccountHistoryDB->ForEachAccountHistory(shouldContinueToNextAccountHistory, startKey);
+        std::vector<HistoryPart> parts(owners.size());
+        // an owner scan reads at least a history row and replays its rewards
+        constexpr const size_t MinOwnersPerThread = 4;
+        ParallelFor(owners.size(), MinOwnersPerThread, [&](size_t begin, size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                const auto& owner = owners[i];
+                scanHistory(parts[i], {owner, maxBlockHeight, std::numeric_limits<uint32_t>::max()}, [&owner](CScript const & key) {
+                    return key == owner;
+                });
+            }
+        });
+
+        // k-way merge of owners' rows by height and txn, both descending like the whole scan.
+        // Rewards have no txn, they take one of the row before them to keep owner's order
+        struct Cursor {
+            uint32_t height;
+            uint32_t txn;
+            size_t owner;
+            decltype(HistoryPart::rows)::iterator position;
+            size_t index;
+        };
+        auto isAfter = [](Cursor const & a, Cursor const & b) {
+            return std::tie(b.height, b.txn, a.owner) > std::tie(a.height, a.txn, b.owner);
+        };
+        std::priority_queue<Cursor, std::vector<Cursor>, decltype(isAfter)> heads(isAfter);
+        auto pushHead = [&](Cursor cursor) {
+            if (cursor.position == parts[cursor.owner].rows.end()) {
+                return;
+            }
+            const auto& row = cursor.position->second[cursor.index];
+            if (cursor.height != cursor.position->first) {
+                cursor.height = cursor.position->first;
+                cursor.txn = std::numeric_limits<uint32_t>::max();
+            }
+            if (boost::get<AccountHistoryValue>(&row.value)) {
+                cursor.txn = row.key.txn;
+            }
+            heads.push(cursor);
+        };
+        for (size_t i = 0; i < parts.size(); ++i) {
+            txs.insert(parts[i].txs.begin(), parts[i].txs.end());
+            auto position = parts[i].rows.begin();
+            pushHead({position != parts[i].rows.end() ? position->first : 0, std::numeric_limits<uint32_t>::max(), i, position, 0});
+        }
+        while (count != 0 && !heads.empty()) {
+            auto cursor = heads.top();
+            heads.pop();
+            ret.emplace(cursor.height, UniValue::VARR).first->second.push_back(rowToJSON(cursor.position->second[cursor.index]));
+            --count;
+            if (++cursor.index == cursor.position->second.size()) {
+                ++cursor.position;
+                cursor.index = 0;
+            }
+            pushHead(cursor);
+        }
+    } else {
+        HistoryPart part;
+        AccountHistoryKey startKey{account, maxBlockHeight, std::numeric_limits<uint32_t>::max()};
+        if (start) {
+            startKey = *start;
+        }
+        scanHistory(part, startKey, isMatchOwner);
+        for (const auto& rows : part.rows) {
+            auto& array = ret.emplace(rows.first, UniValue::VARR).first->second;
+            for (const auto& row : rows.second) {
+                array.push_back(rowToJSON(row));
+            }
+        }
+        txs = std::move(part.txs);
+    }
 
     if (shouldSearchInWallet) {
         count = limit;
@@ -1149,6 +1403,11 @@ UniValue listburnhistory(const JSONRPCRequest& request) {
                         "Filter by transaction type, supported letter from {CustomTxType}"},
                        {"limit", RPCArg::Type::NUM, RPCArg::Optional::OMITTED,
                         "Maximum number of records to return, 100 by default"},
+                       {"start", RPCArg::Type::STR, RPCArg::Optional::OMITTED,
+                        "Optional key of a record to continue from, in the history order. "
+                        "Typically it's set to the key of the last record from previous request."},
+                       {"including_start", RPCArg::Type::BOOL, RPCArg::Optional::OMITTED,
+                        "If true, then iterate including starting position. False by default"},
                    },
                    },
                },
@@ -1167,6 +1426,8 @@ UniValue listburnhistory(const JSONRPCRequest& request) {
     uint32_t limit = 100;
     auto txType = CustomTxType::None;
     bool txTypeSearch{false};
+    boost::optional<AccountHistoryKey> start;
+    bool includingStart = false;
 
     if (request.params.size() == 1) {
         UniValue optionsObj = request.params[0].get_obj();
@@ -1177,6 +1438,8 @@ UniValue listburnhistory(const JSONRPCRequest& request) {
                 {"token", UniValueType(UniValue::VSTR)},
                 {"txtype", UniValueType(UniValue::VSTR)},
                 {"limit", UniValueType(UniValue::VNUM)},
+                {"start", UniValueType(UniValue::VSTR)},
+                {"including_start", UniValueType(UniValue::VBOOL)},
             }, true, true);
 
         if (!optionsObj["maxBlockHeight"].isNull()) {
@@ -1207,12 +1470,23 @@ UniValue listburnhistory(const JSONRPCRequest& request) {
         if (limit == 0) {
             limit = std::numeric_limits<decltype(limit)>::max();
         }
+
+        if (!optionsObj["start"].isNull()) {
+            start = decodeAccountHistoryKey(optionsObj["start"].get_str());
+        }
+        if (!optionsObj["including_start"].isNull()) {
+            includingStart = optionsObj["including_start"].getBool();
+        }
     }
 
     pwallet->BlockUntilSyncedToCurrentChain();
     maxBlockHeight = std::min(maxBlockHeight, uint32_t(chainHeight(*pwallet->chain().lock())));
     depth = std::min(depth, maxBlockHeight);
 
+    if (start && !prepareStartKey(*start, includingStart, maxBlockHeight)) {
+        return UniValue(UniValue::VARR);
+    }
+
     // start block for asc order
     const auto startBlock = maxBlockHeight - depth;
 
@@ -1273,6 +1547,9 @@ UniValue listburnhistory(const JSONRPCRequest& request) {
     };
 
     AccountHistoryKey startKey{{}, maxBlockHeight, std::numeric_limits<uint32_t>::max()};
+    if (start) {
+        startKey = *start;
+    }
     pburnHistoryDB->ForEachAccountHistory(shouldContinueToNextAccountHistory, startKey);
 
     UniValue slice(UniValue::VARR);
@@ -1375,6 +1652,19 @@ UniValue accounthistorycount(const JSONRPCRequest& request) {
     };
 
     LOCK(cs_main);
+
+    // maintained counters answer without rewards replay, when wallet adds nothing
+    if (noRewards && !(isMine && owner.empty()) && paccountHistoryDB->HasHistoryCounts()
+    && (!shouldSearchInWallet || (!owner.empty() && !isMine))) {
+        DCT_ID tokenId;
+        if (tokenFilter.empty()) {
+            return paccountHistoryDB->GetAccountHistoryCount(owner, uint8_t(txType));
+        }
+        if (pcustomcsview->GetTokenGuessId(tokenFilter, tokenId)) {
+            return paccountHistoryDB->GetAccountHistoryCount(owner, uint8_t(txType), tokenId);
+        }
+    }
+
     CCustomCSView view(*pcustomcsview);
     CCoinsViewCache coins(&::ChainstateActive().CoinsTip());
 
@@ -1424,7 +1714,7 @@ UniValue accounthistorycount(const JSONRPCRequest& request) {
     };
 
     AccountHistoryKey startAccountKey{owner, currentHeight, std::numeric_limits<uint32_t>::max()};
-    paccountHistoryDB->ForEachAccountHistory(shouldContinueToNextAccountHistory, startAccountKey);
+    ForEachFilteredAccountHistory(shouldContinueToNextAccountHistory, startAccountKey, tokenFilter, txType);
 
     if (shouldSearchInWallet) {
         searchInWallet(pwallet, owner, filter,
@@ -1616,6 +1906,8 @@ UniValue getburninfo(const JSONRPCRequest& request) {
                "\nReturns burn address and burnt coin and token information.\n"
                "Requires full acindex for correct amount, tokens and feeburn values.\n",
                {
+                   {"height", RPCArg::Type::NUM, RPCArg::Optional::OMITTED,
+                    "Optional height to sum burns up to, inclusive (default = all). Emission burn is always the current one."},
                },
                RPCResult{
                        "{\n"
@@ -1636,39 +1928,51 @@ UniValue getburninfo(const JSONRPCRequest& request) {
                },
     }.Check(request);
 
+    boost::optional<uint32_t> height;
+    if (!request.params[0].isNull()) {
+        height = (uint32_t) request.params[0].get_int64();
+    }
+
     CAmount burntDFI{0};
     CAmount burntFee{0};
     CBalances burntTokens;
-    auto calcBurn = [&](AccountHistoryKey const & key, CLazySerialize<AccountHistoryValue> valueLazy) -> bool
-    {
-        const auto & value = valueLazy.get();
-
+    auto calcBurn = [&](uint8_t category, TAmounts const & diffs) {
         // UTXO burn
-        if (value.category == uint8_t(CustomTxType::None)) {
-            for (auto const & diff : value.diff) {
+        if (category == uint8_t(CustomTxType::None)) {
+            for (auto const & diff : diffs) {
                 burntDFI += diff.second;
             }
-            return true;
+            return;
         }
 
         // Fee burn
-        if (value.category == uint8_t(CustomTxType::CreateMasternode) || value.category == uint8_t(CustomTxType::CreateToken)) {
-            for (auto const & diff : value.diff) {
+        if (category == uint8_t(CustomTxType::CreateMasternode) || category == uint8_t(CustomTxType::CreateToken)) {
+            for (auto const & diff : diffs) {
                 burntFee += diff.second;
             }
-            return true;
+            return;
         }
 
         // Token burn
-        for (auto const & diff : value.diff) {
+        for (auto const & diff : diffs) {
             burntTokens.Add({diff.first, diff.second});
         }
-
-        return true;
     };
 
-    AccountHistoryKey startKey{{}, std::numeric_limits<uint32_t>::max(), std::numeric_limits<uint32_t>::max()};
-    pburnHistoryDB->ForEachAccountHistory(calcBurn, startKey);
+    if (pburnHistoryDB->HasBurnStats()) {
+        for (const auto& stats : pburnHistoryDB->GetBurnStats(height)) {
+            calcBurn(stats.first, stats.second);
+        }
+    } else {
+        AccountHistoryKey startKey{{}, std::numeric_limits<uint32_t>::max(), std::numeric_limits<uint32_t>::max()};
+        pburnHistoryDB->ForEachAccountHistory([&](AccountHistoryKey const & key, CLazySerialize<AccountHistoryValue> valueLazy) {
+            if (!height || key.blockHeight <= *height) {
+                const auto & value = valueLazy.get();
+                calcBurn(value.category, value.diff);
+            }
+            return true;
+        }, startKey);
+    }
 
     UniValue result(UniValue::VOBJ);
     result.pushKV("address", ScriptToString(Params().GetConsensus().burnAddress));
@@ -1682,9 +1986,11 @@ UniValue getburninfo(const JSONRPCRequest& request) {
     result.pushKV("feeburn", ValueFromAmount(burntFee));
 
     CAmount burnt{0};
+    auto snapshot = GetCustomCSSnapshot();
+    CCustomCSView view(*snapshot.storage);
     for (const auto& kv : Params().GetConsensus().newNonUTXOSubsidies) {
         if (kv.first == CommunityAccountType::Unallocated || kv.first == CommunityAccountType::IncentiveFunding) {
-            burnt += pcustomcsview->GetCommunityBalance(kv.first);
+            burnt += view.GetCommunityBalance(kv.first);
             continue;
         }
     }
@@ -1709,7 +2015,7 @@ static const CRPCCommand commands[] =
     {"accounts",    "accounthistorycount",   &accounthistorycount,   {"owner", "options"}},
     {"accounts",    "listcommunitybalances", &listcommunitybalances, {}},
     {"accounts",    "sendtokenstoaddress",   &sendtokenstoaddress,   {"from", "to", "selectionMode"}},
-    {"accounts",    "getburninfo",           &getburninfo,           {}},
+    {"accounts",    "getburninfo",           &getburninfo,           {"height"}},
 };
 
 void RegisterAccountsRPCCommands(CRPCTable& tableRPC) {
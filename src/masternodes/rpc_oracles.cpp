@@ -899,15 +899,10 @@ UniValue listprices(const JSONRPCRequest& request) {
 
     RPCTypeCheck(request.params, {}, false);
 
-    auto locked_chain = pwallet->chain().lock();
-    LOCK(locked_chain->mutex());
-
-    auto optHeight = locked_chain->getHeight();
-    int lastHeight = optHeight ? *optHeight : 0;
-    auto lastBlockTime = locked_chain->getBlockTime(lastHeight);
-
-    CCustomCSView view(*pcustomcsview);
-    return GetAllAggregatePrices(view, lastBlockTime);
+    // aggregation doesn't block block connection
+    auto snapshot = GetCustomCSSnapshot();
+    CCustomCSView view(*snapshot.storage);
+    return GetAllAggregatePrices(view, snapshot.blockTime);
 }
 
 static const CRPCCommand commands[] =
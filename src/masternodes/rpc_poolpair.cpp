@@ -1,4 +1,8 @@
 #include <masternodes/mn_rpc.h>
+#include <masternodes/poolhistory.h>
+#include <masternodes/poolproviders.h>
+
+#include <util/parallel.h>
 
 UniValue poolToJSON(DCT_ID const& id, CPoolPair const& pool, CToken const& token, bool verbose) {
     UniValue poolObj(UniValue::VOBJ);
@@ -13,6 +17,9 @@ UniValue poolToJSON(DCT_ID const& id, CPoolPair const& pool, CToken const& token
         poolObj.pushKV("reserveB", ValueFromAmount(pool.reserveB));
         poolObj.pushKV("commission", ValueFromAmount(pool.commission));
         poolObj.pushKV("totalLiquidity", ValueFromAmount(pool.totalLiquidity));
+        if (ppoolProviders) {
+            poolObj.pushKV("providersCount", (uint64_t) ppoolProviders->GetProvidersCount(id));
+        }
 
         if (pool.reserveB == 0) {
             poolObj.pushKV("reserveA/reserveB", "0");
@@ -932,6 +939,205 @@ UniValue testpoolswap(const JSONRPCRequest& request) {
     return UniValue(res.msg);
 }
 
+UniValue testpoolswaproutes(const JSONRPCRequest& request) {
+
+    RPCHelpMan{"testpoolswaproutes",
+               "\nSimulates swaps over chains of pools at the next block and returns their results.\n"
+               "Without a path the route with the greatest output is searched.\n",
+               {
+                   {"swaps", RPCArg::Type::ARR, RPCArg::Optional::NO, "",
+                       {
+                           {"", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED, "",
+                               {
+                                   {"tokenFrom", RPCArg::Type::STR, RPCArg::Optional::NO,
+                                               "One of the keys may be specified (id/symbol)"},
+                                   {"amountFrom", RPCArg::Type::NUM, RPCArg::Optional::NO,
+                                               "tokenFrom coins amount"},
+                                   {"tokenTo", RPCArg::Type::STR, RPCArg::Optional::NO,
+                                               "One of the keys may be specified (id/symbol)"},
+                                   {"path", RPCArg::Type::ARR, RPCArg::Optional::OMITTED,
+                                               "Pools to swap through in order (id/symbol)",
+                                       {
+                                           {"pool", RPCArg::Type::STR, RPCArg::Optional::OMITTED, ""},
+                                       },
+                                   },
+                                   {"maxHops", RPCArg::Type::NUM, RPCArg::Optional::OMITTED,
+                                               "Maximum number of pools in searched route (default = 3)"},
+                               },
+                           },
+                       },
+                   },
+               },
+               RPCResult{
+                          "[{\"path\":[id,...],\"amount\":\"amount@tokenId\"},...]    (array) Route and output of every swap, or its error\n"
+               },
+               RPCExamples{
+                    HelpExampleCli("testpoolswaproutes", "'[{\"tokenFrom\":\"BTC\","
+                                                    "\"amountFrom\":0.1,"
+                                                    "\"tokenTo\":\"ETH\"}]'")
+                    + HelpExampleRpc("testpoolswaproutes", "[{\"tokenFrom\":\"BTC\","
+                                                    "\"amountFrom\":0.1,"
+                                                    "\"tokenTo\":\"ETH\","
+                                                    "\"path\":[\"BTC-DFI\",\"ETH-DFI\"]}]")
+               },
+    }.Check(request);
+
+    RPCTypeCheck(request.params, {UniValue::VARR}, false);
+
+    // simulation doesn't block block connection
+    auto snapshot = GetCustomCSSnapshot();
+    CCustomCSView mnview(*snapshot.storage);
+    auto graph = GetPoolSwapGraph(snapshot.blockHash, mnview, snapshot.height + 1);
+
+    auto getTokenId = [&](UniValue const & value, std::string const & name) {
+        DCT_ID id;
+        if (!mnview.GetTokenGuessId(value.getValStr(), id)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, name + " was not found: " + value.getValStr());
+        }
+        return id;
+    };
+
+    UniValue ret(UniValue::VARR);
+    for (const auto& swap : request.params[0].get_array().getValues()) {
+        const auto& swapObj = swap.get_obj();
+        CTokenAmount in{getTokenId(swapObj["tokenFrom"], "tokenFrom"), AmountFromValue(swapObj["amountFrom"])};
+        auto tokenTo = getTokenId(swapObj["tokenTo"], "tokenTo");
+
+        UniValue result(UniValue::VOBJ);
+        ResVal<CPoolSwapPath> res = Res::Err("");
+        if (!swapObj["path"].isNull()) {
+            std::vector<DCT_ID> path;
+            for (const auto& pool : swapObj["path"].get_array().getValues()) {
+                path.push_back(getTokenId(pool, "Pool"));
+            }
+            auto out = graph->Swap(in, path);
+            if (out && out.val->nTokenId != tokenTo) {
+                out = Res::Err("Path ends with token %s", out.val->nTokenId.ToString());
+            }
+            res = !out ? ResVal<CPoolSwapPath>(out) : ResVal<CPoolSwapPath>(CPoolSwapPath{path, *out.val}, Res::Ok());
+        } else {
+            auto maxHops = CPoolSwapGraph::DEFAULT_MAX_HOPS;
+            if (!swapObj["maxHops"].isNull()) {
+                auto hops = swapObj["maxHops"].get_int();
+                if (hops < 1) {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "maxHops should be positive");
+                }
+                maxHops = hops;
+            }
+            res = graph->FindBestPath(in, tokenTo, maxHops);
+        }
+
+        if (res) {
+            UniValue path(UniValue::VARR);
+            for (const auto& poolId : res.val->pools) {
+                path.push_back(poolId.ToString());
+            }
+            result.pushKV("path", path);
+            result.pushKV("amount", res.val->amount.ToString());
+        } else {
+            result.pushKV("error", res.msg);
+        }
+        ret.push_back(result);
+    }
+    return ret;
+}
+
+UniValue testpoolswaps(const JSONRPCRequest& request) {
+
+    RPCHelpMan{"testpoolswaps",
+               "\nTests many poolswaps against the same chain tip state and returns their results in order.\n"
+               "Every swap is tested independently of the others.\n",
+               {
+                   {"swaps", RPCArg::Type::ARR, RPCArg::Optional::NO, "",
+                       {
+                           {"", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED, "",
+                               {
+                                   {"tokenFrom", RPCArg::Type::STR, RPCArg::Optional::NO,
+                                               "One of the keys may be specified (id/symbol)"},
+                                   {"amountFrom", RPCArg::Type::NUM, RPCArg::Optional::NO,
+                                               "tokenFrom coins amount"},
+                                   {"tokenTo", RPCArg::Type::STR, RPCArg::Optional::NO,
+                                               "One of the keys may be specified (id/symbol)"},
+                                   {"maxPrice", RPCArg::Type::NUM, RPCArg::Optional::OMITTED,
+                                               "Maximum acceptable price"},
+                               },
+                           },
+                       },
+                   },
+               },
+               RPCResult{
+                          "[\"amount@tokenId\",{\"error\":\"...\"},...]    (array) Result of every poolswap in format AMOUNT@TOKENID, or its error\n"
+               },
+               RPCExamples{
+                    HelpExampleCli("testpoolswaps", "'[{\"tokenFrom\":\"BTC\",\"amountFrom\":0.1,\"tokenTo\":\"DFI\"},"
+                                                    "{\"tokenFrom\":\"DFI\",\"amountFrom\":100,\"tokenTo\":\"ETH\",\"maxPrice\":0.01}]'")
+                    + HelpExampleRpc("testpoolswaps", "[{\"tokenFrom\":\"BTC\",\"amountFrom\":0.1,\"tokenTo\":\"DFI\"}]")
+               },
+    }.Check(request);
+
+    RPCTypeCheck(request.params, {UniValue::VARR}, false);
+
+    // quotes don't block block connection
+    auto snapshot = GetCustomCSSnapshot();
+    CCustomCSView mnview(*snapshot.storage);
+    auto graph = GetPoolSwapGraph(snapshot.blockHash, mnview, snapshot.height + 1);
+
+    struct Quote {
+        CTokenAmount in;
+        DCT_ID tokenTo;
+        PoolPrice maxPrice;
+        Res res = Res::Ok();
+    };
+    std::vector<Quote> quotes;
+    for (const auto& swap : request.params[0].get_array().getValues()) {
+        const auto& swapObj = swap.get_obj();
+        Quote quote;
+        if (!mnview.GetTokenGuessId(swapObj["tokenFrom"].getValStr(), quote.in.nTokenId)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "TokenFrom was not found: " + swapObj["tokenFrom"].getValStr());
+        }
+        if (!mnview.GetTokenGuessId(swapObj["tokenTo"].getValStr(), quote.tokenTo)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "TokenTo was not found: " + swapObj["tokenTo"].getValStr());
+        }
+        quote.in.nValue = AmountFromValue(swapObj["amountFrom"]);
+        if (!swapObj["maxPrice"].isNull()) {
+            CAmount maxPrice = AmountFromValue(swapObj["maxPrice"]);
+            quote.maxPrice.integer = maxPrice / COIN;
+            quote.maxPrice.fraction = maxPrice % COIN;
+        } else {
+            quote.maxPrice.integer = INT64_MAX;
+            quote.maxPrice.fraction = INT64_MAX;
+        }
+        quotes.push_back(std::move(quote));
+    }
+
+    // quotes share immutable graph only, so they are spread over cores
+    constexpr const size_t MinQuotesPerThread = 256;
+    ParallelFor(quotes.size(), MinQuotesPerThread, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            auto& quote = quotes[i];
+            auto poolId = graph->GetPoolId(quote.in.nTokenId, quote.tokenTo);
+            if (!poolId) {
+                quote.res = Res::Err("Can't find the poolpair %s-%s", quote.in.nTokenId.ToString(), quote.tokenTo.ToString());
+                continue;
+            }
+            auto out = graph->SwapPool(quote.in, *poolId, quote.maxPrice);
+            quote.res = !out ? Res(out) : Res::Ok("%s", out.val->ToString());
+        }
+    });
+
+    UniValue ret(UniValue::VARR);
+    for (const auto& quote : quotes) {
+        if (quote.res) {
+            ret.push_back(quote.res.msg);
+        } else {
+            UniValue error(UniValue::VOBJ);
+            error.pushKV("error", quote.res.msg);
+            ret.push_back(error);
+        }
+    }
+    return ret;
+}
+
 UniValue listpoolshares(const JSONRPCRequest& request) {
     RPCHelpMan{"listpoolshares",
                "\nReturns information about pool shares.\n",
@@ -950,12 +1156,15 @@ UniValue listpoolshares(const JSONRPCRequest& request) {
                                     "Flag for verbose list (default = true), otherwise only % are shown."},
                         {"is_mine_only", RPCArg::Type::BOOL, RPCArg::Optional::OMITTED,
                                     "Get shares for all accounts belonging to the wallet (default = false)"},
+                        {"owner", RPCArg::Type::STR, RPCArg::Optional::OMITTED,
+                                    "Get shares of the address only"},
                },
                RPCResult{
                        "{id:{...},...}     (array) Json object with pools information\n"
                },
                RPCExamples{
                        HelpExampleCli("listpoolshares", "'{\"start\":128}' false false")
+                       + HelpExampleCli("listpoolshares", "'{}' true false \"dPyup5C9hfRd2SUC1p3a7VcjcNuGSXa9bT\"")
                        + HelpExampleRpc("listpoolshares", "'{\"start\":128}' false false")
                },
     }.Check(request);
@@ -970,6 +1179,11 @@ UniValue listpoolshares(const JSONRPCRequest& request) {
         isMineOnly = request.params[2].get_bool();
     }
 
+    CScript owner;
+    if (request.params.size() > 3) {
+        owner = DecodeScript(request.params[3].get_str());
+    }
+
     CWallet* const pwallet = GetWallet(request);
 
     // parse pagination
@@ -998,17 +1212,19 @@ UniValue listpoolshares(const JSONRPCRequest& request) {
         }
     }
 
-    LOCK(cs_main);
+    // scan doesn't block block connection
+    auto snapshot = GetCustomCSSnapshot();
+    CCustomCSView mnview(*snapshot.storage);
 
     PoolShareKey startKey{ start, CScript{} };
 //    startKey.poolID = start;
 //    startKey.owner = CScript(0);
 
     UniValue ret(UniValue::VOBJ);
-    pcustomcsview->ForEachPoolShare([&](DCT_ID const & poolId, CScript const & provider, uint32_t) {
-        const CTokenAmount tokenAmount = pcustomcsview->GetBalance(provider, poolId);
+    auto onShare = [&](DCT_ID const & poolId, CScript const & provider) {
+        const CTokenAmount tokenAmount = mnview.GetBalance(provider, poolId);
         if(tokenAmount.nValue) {
-            const auto poolPair = pcustomcsview->GetPoolPair(poolId);
+            const auto poolPair = mnview.GetPoolPair(poolId);
             if(poolPair) {
                 if (isMineOnly) {
                     if (IsMineCached(*pwallet, provider) == ISMINE_SPENDABLE) {
@@ -1023,8 +1239,187 @@ UniValue listpoolshares(const JSONRPCRequest& request) {
         }
 
         return limit != 0;
-    }, startKey);
+    };
+
+    if (!owner.empty()) {
+        mnview.ForEachOwnerShare(owner, [&](DCT_ID const & poolId, uint32_t) {
+            return onShare(poolId, owner);
+        }, start);
+    } else {
+        mnview.ForEachPoolShare([&](DCT_ID const & poolId, CScript const & provider, uint32_t) {
+            return onShare(poolId, provider);
+        }, startKey);
+    }
+
+    return ret;
+}
+
+UniValue getpoolproviders(const JSONRPCRequest& request) {
+    RPCHelpMan{"getpoolproviders",
+               "\nReturns number of liquidity providers of the pool and the largest of them.\n",
+               {
+                       {"key", RPCArg::Type::STR, RPCArg::Optional::NO,
+                        "One of the keys may be specified (id/symbol/creationTx)"},
+                       {"limit", RPCArg::Type::NUM, RPCArg::Optional::OMITTED,
+                        "Maximum number of providers to return, 10 by default"},
+               },
+               RPCResult{
+                       "{\n"
+                       "  \"providersCount\": n,       (numeric) Number of providers\n"
+                       "  \"totalLiquidity\": x.xxx,   (numeric) Total liquidity of the pool\n"
+                       "  \"providers\": [{...},...]   (array) Providers with the largest liquidity first\n"
+                       "}\n"
+               },
+               RPCExamples{
+                       HelpExampleCli("getpoolproviders", "GOLD-DFI 20")
+                       + HelpExampleRpc("getpoolproviders", "\"GOLD-DFI\", 20")
+               },
+    }.Check(request);
+
+    size_t limit = 10;
+    if (request.params.size() > 1) {
+        limit = (size_t) request.params[1].get_int64();
+    }
+
+    auto providers = ppoolProviders.get();
+    if (!providers) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Pool providers are not available");
+    }
+
+    LOCK(cs_main);
+
+    DCT_ID id;
+    auto token = pcustomcsview->GetTokenGuessId(request.params[0].getValStr(), id);
+    if (!token) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Pool not found");
+    }
+    auto pool = pcustomcsview->GetPoolPair(id);
+    if (!pool) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Pool not found");
+    }
+
+    UniValue top(UniValue::VARR);
+    for (const auto& provider : providers->GetTopProviders(id, limit)) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("owner", ScriptToString(provider.first));
+        obj.pushKV("amount", ValueFromAmount(provider.second));
+        top.push_back(obj);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("providersCount", (uint64_t) providers->GetProvidersCount(id));
+    ret.pushKV("totalLiquidity", ValueFromAmount(pool->totalLiquidity));
+    ret.pushKV("providers", top);
+    return ret;
+}
 
+UniValue getpoolhistory(const JSONRPCRequest& request) {
+    RPCHelpMan{"getpoolhistory",
+               "\nReturns reserveB/reserveA price candles and swap volumes of the pool over range of blocks.\n"
+               "Requires -poolhistoryindex.\n",
+               {
+                       {"key", RPCArg::Type::STR, RPCArg::Optional::NO,
+                        "One of the keys may be specified (id/symbol/creationTx)"},
+                       {"start", RPCArg::Type::NUM, RPCArg::Optional::NO,
+                        "First block height of the range"},
+                       {"end", RPCArg::Type::NUM, RPCArg::Optional::NO,
+                        "Last block height of the range"},
+                       {"interval", RPCArg::Type::NUM, RPCArg::Optional::OMITTED,
+                        "Number of blocks per candle (default = whole range)"},
+               },
+               RPCResult{
+                       "[{...},...]     (array) Json objects of candles in height order\n"
+                       "  \"from\", \"to\"  candle's blocks\n"
+                       "  \"open\"        price before the first block\n"
+                       "  \"high\", \"low\", \"close\"  prices at the end of candle's blocks\n"
+                       "  \"volumeA\", \"volumeB\"  amounts swapped into the pool, fees included\n"
+                       "  \"reserveA\", \"reserveB\", \"totalLiquidity\"  pool state at the end of the candle\n"
+               },
+               RPCExamples{
+                       HelpExampleCli("getpoolhistory", "GOLD-DFI 100000 102880 2880")
+                       + HelpExampleRpc("getpoolhistory", "\"GOLD-DFI\", 100000, 102880, 2880")
+               },
+    }.Check(request);
+
+    if (!ppoolHistoryDB) {
+        throw JSONRPCError(RPC_INVALID_REQUEST, "-poolhistoryindex is needed for pool history");
+    }
+
+    const auto start = request.params[1].get_int();
+    const auto end = request.params[2].get_int();
+    if (start < 0 || end < start) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid range of heights");
+    }
+    uint32_t interval = end - start + 1;
+    if (request.params.size() > 3) {
+        const auto value = request.params[3].get_int();
+        if (value <= 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "interval should be positive");
+        }
+        interval = std::min(uint32_t(value), interval);
+    }
+
+    LOCK(cs_main);
+
+    DCT_ID id;
+    auto token = pcustomcsview->GetTokenGuessId(request.params[0].getValStr(), id);
+    if (!token || !pcustomcsview->HasPoolPair(id)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Pool not found");
+    }
+
+    // records of the range and the last one before it, single scan from the end
+    std::vector<std::pair<uint32_t, PoolHistoryValue>> records;
+    ppoolHistoryDB->ForEachPoolHistory(id, [&](uint32_t height, PoolHistoryValue const & value) {
+        records.emplace_back(height, value);
+        return height >= uint32_t(start);
+    }, end);
+    std::reverse(records.begin(), records.end());
+
+    auto price = [](PoolHistoryValue const & value) -> CAmount {
+        if (value.reserveA == 0) {
+            return 0;
+        }
+        return (arith_uint256(value.reserveB) * arith_uint256(COIN) / value.reserveA).GetLow64();
+    };
+
+    PoolHistoryValue state;
+    auto it = records.begin();
+    if (it != records.end() && it->first < uint32_t(start)) {
+        state = it->second;
+        ++it;
+    }
+
+    UniValue ret(UniValue::VARR);
+    for (uint32_t from = start; from <= uint32_t(end); from += interval) {
+        const auto to = std::min(uint32_t(end), from + interval - 1);
+        const auto open = price(state);
+        CAmount high = open, low = open, volumeA = 0, volumeB = 0;
+        for (; it != records.end() && it->first <= to; ++it) {
+            state = it->second;
+            volumeA += state.volumeA;
+            volumeB += state.volumeB;
+            if (const auto current = price(state)) {
+                high = std::max(high, current);
+                low = low ? std::min(low, current) : current;
+            }
+        }
+        UniValue candle(UniValue::VOBJ);
+        candle.pushKV("from", uint64_t(from));
+        candle.pushKV("to", uint64_t(to));
+        candle.pushKV("open", ValueFromAmount(open));
+        candle.pushKV("high", ValueFromAmount(high));
+        candle.pushKV("low", ValueFromAmount(low));
+        candle.pushKV("close", ValueFromAmount(price(state)));
+        candle.pushKV("volumeA", ValueFromAmount(volumeA));
+        candle.pushKV("volumeB", ValueFromAmount(volumeB));
+        candle.pushKV("reserveA", ValueFromAmount(state.reserveA));
+        candle.pushKV("reserveB", ValueFromAmount(state.reserveB));
+        candle.pushKV("totalLiquidity", ValueFromAmount(state.totalLiquidity));
+        ret.push_back(candle);
+        if (to == uint32_t(end)) {
+            break;
+        }
+    }
     return ret;
 }
 
@@ -1039,8 +1434,12 @@ static const CRPCCommand commands[] =
     {"poolpair",    "createpoolpair",        &createpoolpair,        {"metadata", "inputs"}},
     {"poolpair",    "updatepoolpair",        &updatepoolpair,        {"metadata", "inputs"}},
     {"poolpair",    "poolswap",              &poolswap,              {"metadata", "inputs"}},
-    {"poolpair",    "listpoolshares",        &listpoolshares,        {"pagination", "verbose", "is_mine_only"}},
+    {"poolpair",    "listpoolshares",        &listpoolshares,        {"pagination", "verbose", "is_mine_only", "owner"}},
+    {"poolpair",    "getpoolproviders",      &getpoolproviders,      {"key", "limit"}},
     {"poolpair",    "testpoolswap",          &testpoolswap,          {"metadata"}},
+    {"poolpair",    "testpoolswaproutes",    &testpoolswaproutes,    {"swaps"}},
+    {"poolpair",    "testpoolswaps",         &testpoolswaps,         {"swaps"}},
+    {"poolpair",    "getpoolhistory",        &getpoolhistory,        {"key", "start", "end", "interval"}},
 };
 
 void RegisterPoolpairRPCCommands(CRPCTable& tableRPC) {
@@ -28,10 +28,10 @@ struct UndoKey {
 struct CUndo {
     MapKV before;
 
-    static CUndo Construct(CStorageKV const & before, MapKV const & diff) {
+    static CUndo Construct(CStorageKV const & before, CStorageWriteBuffer const & diff) {
         CUndo result;
         for (const auto & kv : diff) {
-            const auto& beforeKey = kv.first;
+            auto beforeKey = ToBytes(kv.first);
             TBytes beforeVal;
             if (before.Read(beforeKey, beforeVal)) {
                 result.before[beforeKey] = std::move(beforeVal);
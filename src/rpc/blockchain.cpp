@@ -1531,6 +1531,38 @@ static UniValue getmempoolinfo(const JSONRPCRequest& request)
     return MempoolInfoToJSON(::mempool);
 }
 
+static UniValue getcompactionstats(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getcompactionstats",
+                "\nReturns statistics of background compaction of enhanced chainstate database.\n",
+                {},
+                RPCResult{
+            "{\n"
+            "  \"pending\": xxxxx,             (numeric) Tables with erased key ranges waiting for compaction\n"
+            "  \"added\": xxxxx,               (numeric) Erased key ranges added by flushes since start\n"
+            "  \"compacted\": xxxxx,           (numeric) Key ranges compacted since start\n"
+            "  \"time\": xxxxx,                (numeric) Time spent in compaction since start, in milliseconds\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getcompactionstats", "")
+            + HelpExampleRpc("getcompactionstats", "")
+                },
+            }.Check(request);
+
+    LOCK(cs_main);
+    if (!pcustomcsDB) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Enhanced chainstate database is not loaded");
+    }
+    auto stats = pcustomcsDB->GetCompactionStats();
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("pending", uint64_t(stats.pending));
+    ret.pushKV("added", stats.added);
+    ret.pushKV("compacted", stats.compacted);
+    ret.pushKV("time", stats.time / 1000);
+    return ret;
+}
+
 static UniValue preciousblock(const JSONRPCRequest& request)
 {
             RPCHelpMan{"preciousblock",
@@ -2343,6 +2375,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  {"txid","verbose"} },
     { "blockchain",         "getmempoolentry",        &getmempoolentry,        {"txid"} },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
+    { "blockchain",         "getcompactionstats",     &getcompactionstats,     {} },
     { "blockchain",         "clearmempool",           &clearmempool,           {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
@@ -248,10 +248,17 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "listpoolshares", 0, "pagination" },
     { "listpoolshares", 1, "verbose" },
     { "listpoolshares", 2, "is_mine_only" },
+    { "testpoolswaproutes", 0, "swaps" },
+    { "testpoolswaps", 0, "swaps" },
+    { "getpoolproviders", 1, "limit" },
+    { "getpoolhistory", 1, "start" },
+    { "getpoolhistory", 2, "end" },
+    { "getpoolhistory", 3, "interval" },
 
     { "listaccounthistory", 1, "options" },
     { "listburnhistory", 0, "options" },
     { "accounthistorycount", 1, "options" },
+    { "getburninfo", 0, "height" },
 
     { "setgov", 0, "variables" },
     { "setgov", 1, "inputs" },
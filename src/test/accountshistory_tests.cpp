@@ -0,0 +1,169 @@
+// Copyright (c) DeFi Blockchain Developers
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+
+#include <masternodes/accountshistory.h>
+#include <masternodes/mn_checks.h>
+
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+struct AccountsHistoryTestingSetup : public BasicTestingSetup {
+    using Record = std::pair<AccountHistoryKey, AccountHistoryValue>;
+    using Filter = std::function<bool(AccountHistoryKey const &, AccountHistoryValue const &)>;
+
+    const CScript alice = CScript(3000), bob = CScript(3001);
+    const uint256 tx1 = uint256S("a1"), tx2 = uint256S("a2"), tx3 = uint256S("a3");
+    const uint8_t swap = uint8_t(CustomTxType::PoolSwap), transfer = uint8_t(CustomTxType::AccountToAccount);
+
+    // a swap of alice, a transfer from alice to bob and a swap of bob
+    void WriteRecords(CAccountsHistoryView & history) const {
+        history.WriteAccountHistory({alice, 10, 1}, {tx1, swap, {{DCT_ID{0}, -COIN}, {DCT_ID{1}, COIN}}});
+        history.WriteAccountHistory({alice, 12, 0}, {tx2, transfer, {{DCT_ID{1}, -COIN}}});
+        history.WriteAccountHistory({bob, 12, 0}, {tx2, transfer, {{DCT_ID{1}, COIN}}});
+        history.WriteAccountHistory({bob, 15, 3}, {tx3, swap, {{DCT_ID{0}, COIN}, {DCT_ID{2}, -COIN}}});
+    }
+
+    // records of the full scan passing the filter, indexes and statistics should match them
+    static std::vector<Record> Scan(CAccountsHistoryView & history, Filter filter, AccountHistoryKey const & start = {}) {
+        std::vector<Record> records;
+        history.ForEachAccountHistory([&](AccountHistoryKey const & key, CLazySerialize<AccountHistoryValue> value) {
+            if (filter(key, value.get())) {
+                records.emplace_back(key, value.get());
+            }
+            return true;
+        }, start);
+        return records;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(accountshistory_tests, AccountsHistoryTestingSetup)
+
+BOOST_AUTO_TEST_CASE(account_history_secondary_indexes)
+{
+    CAccountHistoryStorage history{"history_indexes", 1 << 20, true, true, true};
+    BOOST_REQUIRE(history.HasSecondaryIndexes());
+    WriteRecords(history);
+    history.Flush();
+
+    using Row = std::tuple<CScript, uint32_t, uint256>;
+    auto collect = [](std::vector<Row> & rows) {
+        return [&rows](AccountHistoryKey const & key, CLazySerialize<AccountHistoryValue> value) {
+            rows.emplace_back(key.owner, key.blockHeight, value.get().txid);
+            return true;
+        };
+    };
+    auto scan = [&](std::function<bool(AccountHistoryValue const &)> filter, AccountHistoryKey const & start) {
+        std::vector<Row> rows;
+        for (const auto& record : Scan(history, [&](AccountHistoryKey const &, AccountHistoryValue const & value) { return filter(value); }, start)) {
+            rows.emplace_back(record.first.owner, record.first.blockHeight, record.second.txid);
+        }
+        return rows;
+    };
+
+    for (const auto& start : {AccountHistoryKey{}, AccountHistoryKey{bob, 14, std::numeric_limits<uint32_t>::max()}}) {
+        std::vector<Row> byTxid, byToken, byCategory;
+        history.ForEachAccountHistoryByTxid(tx2, collect(byTxid), start);
+        history.ForEachAccountHistoryByToken(DCT_ID{1}, collect(byToken), start);
+        history.ForEachAccountHistoryByCategory(swap, collect(byCategory), start);
+        BOOST_CHECK(byTxid == scan([&](AccountHistoryValue const & value) { return value.txid == tx2; }, start));
+        BOOST_CHECK(byToken == scan([&](AccountHistoryValue const & value) { return value.diff.count(DCT_ID{1}) > 0; }, start));
+        BOOST_CHECK(byCategory == scan([&](AccountHistoryValue const & value) { return value.category == swap; }, start));
+    }
+
+    // erased records are removed from indexes
+    history.EraseAccountHistory({alice, 12, 0});
+    history.EraseAccountHistory({bob, 12, 0});
+    history.Flush();
+    std::vector<Row> rows;
+    history.ForEachAccountHistoryByTxid(tx2, collect(rows));
+    history.ForEachAccountHistoryByCategory(transfer, collect(rows));
+    BOOST_CHECK(rows.empty());
+    history.ForEachAccountHistoryByToken(DCT_ID{1}, collect(rows));
+    BOOST_REQUIRE_EQUAL(rows.size(), 1);
+    BOOST_CHECK(std::get<2>(rows[0]) == tx1);
+}
+
+BOOST_AUTO_TEST_CASE(account_history_counts)
+{
+    CAccountHistoryStorage history{"history_counts", 1 << 20, true, true};
+    BOOST_REQUIRE(history.HasHistoryCounts());
+    WriteRecords(history);
+    // counters are written by flush
+    BOOST_CHECK_EQUAL(history.GetAccountHistoryCount(alice), 0);
+    history.Flush();
+
+    auto checkCounts = [&]() {
+        for (const auto& owner : {alice, bob, CScript{}}) {
+            for (const auto category : {uint8_t(0), swap, transfer}) {
+                for (const auto& token : {boost::optional<DCT_ID>{}, boost::optional<DCT_ID>{DCT_ID{0}}, boost::optional<DCT_ID>{DCT_ID{1}}, boost::optional<DCT_ID>{DCT_ID{2}}}) {
+                    auto records = Scan(history, [&](AccountHistoryKey const & key, AccountHistoryValue const & value) {
+                        return (owner.empty() || key.owner == owner)
+                            && (category == 0 || value.category == category)
+                            && (!token || value.diff.count(*token) > 0);
+                    });
+                    BOOST_CHECK_EQUAL(history.GetAccountHistoryCount(owner, category, token), records.size());
+                }
+            }
+        }
+    };
+    checkCounts();
+    BOOST_CHECK_EQUAL(history.GetAccountHistoryCount({}), 4);
+    BOOST_CHECK_EQUAL(history.GetAccountHistoryCount(alice, 0, DCT_ID{1}), 2);
+
+    // erases and discarded changes
+    history.EraseAccountHistory({alice, 12, 0});
+    history.EraseAccountHistory({bob, 12, 0});
+    history.Discard();
+    checkCounts();
+    history.EraseAccountHistory({alice, 12, 0});
+    history.EraseAccountHistory({bob, 12, 0});
+    history.Flush();
+    checkCounts();
+    BOOST_CHECK_EQUAL(history.GetAccountHistoryCount({}, transfer), 0);
+}
+
+BOOST_AUTO_TEST_CASE(burn_history_stats)
+{
+    CBurnHistoryStorage history{"burn_stats", 1 << 20, true, true};
+    BOOST_REQUIRE(history.HasBurnStats());
+
+    const CScript burn(3200), oldBurn(3201);
+    const auto interval = CAccountsHistoryView::BurnStatsInterval;
+    const uint8_t utxo = uint8_t(CustomTxType::None), fee = uint8_t(CustomTxType::CreateToken);
+    history.WriteAccountHistory({burn, 10, 0}, {tx1, utxo, {{DCT_ID{0}, 5 * COIN}}});
+    history.WriteAccountHistory({burn, interval + 5, 1}, {tx2, fee, {{DCT_ID{0}, COIN}}});
+    history.WriteAccountHistory({burn, interval + 7, 2}, {tx3, transfer, {{DCT_ID{1}, 3 * COIN}, {DCT_ID{2}, COIN}}});
+    history.WriteAccountHistory({oldBurn, interval + 6, 0}, {tx3, transfer, {{DCT_ID{1}, COIN}}});
+    history.WriteAccountHistory({burn, 2 * interval, 0}, {tx1, utxo, {{DCT_ID{0}, 2 * COIN}}});
+    history.Flush();
+
+    auto scan = [&](boost::optional<uint32_t> height) {
+        std::map<uint8_t, TAmounts> stats;
+        for (const auto& record : Scan(history, [&](AccountHistoryKey const & key, AccountHistoryValue const &) { return !height || key.blockHeight <= *height; })) {
+            for (const auto& diff : record.second.diff) {
+                stats[record.second.category][diff.first] += diff.second;
+            }
+        }
+        return stats;
+    };
+    auto checkStats = [&]() {
+        BOOST_CHECK(history.GetBurnStats() == scan({}));
+        for (const auto height : {uint32_t(0), uint32_t(10), interval - 1, interval + 5, interval + 6, 2 * interval - 1, 2 * interval, 3 * interval}) {
+            BOOST_CHECK(history.GetBurnStats(height) == scan(height));
+        }
+    };
+    checkStats();
+    BOOST_CHECK_EQUAL(history.GetBurnStats()[transfer][DCT_ID{1}], 4 * COIN);
+    BOOST_CHECK_EQUAL(history.GetBurnStats(interval + 6)[transfer][DCT_ID{1}], COIN);
+
+    // erased records are subtracted
+    history.EraseAccountHistory({burn, interval + 7, 2});
+    history.EraseAccountHistory({burn, 2 * interval, 0});
+    history.Flush();
+    checkStats();
+    BOOST_CHECK_EQUAL(history.GetBurnStats()[utxo][DCT_ID{0}], 5 * COIN);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,5 +1,8 @@
 #include <chainparams.h>
+#include <masternodes/accountshistory.h>
 #include <masternodes/masternodes.h>
+#include <masternodes/poolhistory.h>
+#include <masternodes/poolproviders.h>
 #include <masternodes/poolpairs.h>
 #include <validation.h>
 
@@ -353,6 +356,67 @@ BOOST_AUTO_TEST_CASE(math_rewards)
     }
 }
 
+BOOST_AUTO_TEST_CASE(update_pool_rewards)
+{
+    const int PoolCount = 40; // enough to be read by several threads
+    const int ProvidersCount = 2;
+
+    CCustomCSView mnview(*pcustomcsview);
+
+    for (int i = 0; i < PoolCount; ++i) {
+        CreatePoolNTokens(mnview, "A"+std::to_string(i), "B"+std::to_string(i));
+    }
+    mnview.ForEachPoolId([&] (DCT_ID const & idPool) {
+        for (int i = 0; i < ProvidersCount; ++i) {
+            BOOST_CHECK(AddPoolLiquidity(mnview, idPool, idPool.v*COIN, idPool.v*COIN, CScript(idPool.v * ProvidersCount + i)).ok);
+        }
+        SetPoolRewardPct(mnview, idPool, COIN/PoolCount);
+        SetPoolTradeFees(mnview, idPool, idPool.v * COIN, idPool.v * COIN*2);
+        return true;
+    });
+    mnview.SetDailyReward(1, 100*COIN*2880);
+
+    CAmount distributed = mnview.UpdatePoolRewards(
+        [&](CScript const & owner, DCT_ID tokenID) {
+            return mnview.GetBalance(owner, tokenID);
+        },
+        [&](CScript const & from, CScript const & to, CTokenAmount amount) {
+            if (!from.empty()) {
+                auto res = mnview.SubBalance(from, amount);
+                if (!res) {
+                    return res;
+                }
+            }
+            return mnview.AddBalance(to, amount);
+        },
+        1
+    );
+
+    // pools are paid in the same way as they are updated one by one
+    constexpr const uint32_t PRECISION = 10000;
+    CAmount totalRewards = 0;
+    mnview.ForEachPoolPair([&] (DCT_ID const & idPool, CPoolPair pool) {
+        CAmount feesA = 0, feesB = 0;
+        for (int i = 0; i < ProvidersCount; ++i) {
+            CScript provider(idPool.v * ProvidersCount + i);
+            uint32_t liqWeight = mnview.GetBalance(provider, idPool).nValue * PRECISION / pool.totalLiquidity;
+            CAmount feeA = mnview.GetBalance(provider, pool.idTokenA).nValue;
+            CAmount feeB = mnview.GetBalance(provider, pool.idTokenB).nValue;
+            BOOST_CHECK_EQUAL(feeA, idPool.v * COIN * liqWeight / PRECISION);
+            BOOST_CHECK_EQUAL(feeB, idPool.v * COIN * 2 * liqWeight / PRECISION);
+            feesA += feeA;
+            feesB += feeB;
+            totalRewards += mnview.GetBalance(provider, DCT_ID{0}).nValue;
+        }
+        // undistributed commissions are left to the next block
+        BOOST_CHECK_EQUAL(pool.blockCommissionA, idPool.v * COIN - feesA);
+        BOOST_CHECK_EQUAL(pool.blockCommissionB, idPool.v * COIN * 2 - feesB);
+        return true;
+    });
+    BOOST_CHECK(totalRewards > 0);
+    BOOST_CHECK_EQUAL(distributed, totalRewards);
+}
+
 BOOST_AUTO_TEST_CASE(owner_rewards)
 {
     CCustomCSView mnview(*pcustomcsview);
@@ -486,4 +550,472 @@ BOOST_AUTO_TEST_CASE(owner_rewards)
     });
 }
 
+BOOST_AUTO_TEST_CASE(owner_share_index)
+{
+    CCustomCSView mnview(*pcustomcsview);
+    const CScript owner(42), other(43);
+
+    // shares written before the index are probed pool by pool until it is built
+    DCT_ID idA, idB, idPool;
+    std::tie(idA, idB, idPool) = CreatePoolNTokens(mnview, "OSA", "OSB");
+    mnview.WriteBy<CPoolPairView::ByShare>(PoolShareKey{idPool, owner}, uint32_t(5));
+    BOOST_CHECK(!mnview.HasOwnerShareIndex());
+    std::vector<std::pair<uint32_t, uint32_t>> shares;
+    auto collect = [&](DCT_ID const & poolId, uint32_t height) {
+        shares.emplace_back(poolId.v, height);
+        return true;
+    };
+    mnview.ForEachOwnerShare(owner, collect);
+    BOOST_REQUIRE_EQUAL(shares.size(), 1);
+    BOOST_CHECK(shares[0] == std::make_pair(idPool.v, 5u));
+    BOOST_CHECK(mnview.BuildOwnerShareIndex());
+    BOOST_CHECK(!mnview.BuildOwnerShareIndex());
+    shares.clear();
+    mnview.ForEachOwnerShare(owner, collect);
+    BOOST_REQUIRE_EQUAL(shares.size(), 1);
+    BOOST_CHECK(shares[0] == std::make_pair(idPool.v, 5u));
+    BOOST_REQUIRE(mnview.DelShare(idPool, owner).ok);
+
+    BOOST_REQUIRE(mnview.SetShare(DCT_ID{7}, owner, 10).ok);
+    BOOST_REQUIRE(mnview.SetShare(DCT_ID{300}, owner, 20).ok);
+    BOOST_REQUIRE(mnview.SetShare(DCT_ID{5}, other, 30).ok);
+    BOOST_REQUIRE(mnview.SetShare(DCT_ID{8}, owner, 40).ok);
+    BOOST_REQUIRE(mnview.DelShare(DCT_ID{8}, owner).ok);
+
+    shares.clear();
+    mnview.ForEachOwnerShare(owner, [&](DCT_ID const & poolId, uint32_t height) {
+        BOOST_CHECK_EQUAL(*mnview.GetShare(poolId, owner), height);
+        shares.emplace_back(poolId.v, height);
+        return true;
+    });
+    BOOST_REQUIRE_EQUAL(shares.size(), 2);
+    BOOST_CHECK(shares[0] == std::make_pair(7u, 10u));
+    BOOST_CHECK(shares[1] == std::make_pair(300u, 20u));
+
+    shares.clear();
+    mnview.ForEachOwnerShare(owner, [&](DCT_ID const & poolId, uint32_t height) {
+        shares.emplace_back(poolId.v, height);
+        return true;
+    }, DCT_ID{8});
+    BOOST_REQUIRE_EQUAL(shares.size(), 1);
+    BOOST_CHECK_EQUAL(shares[0].first, 300);
+}
+
+BOOST_AUTO_TEST_CASE(owner_share_index_merkle_root)
+{
+    CCustomCSView mnview(*pcustomcsview);
+    DCT_ID idA, idB, idPool;
+    std::tie(idA, idB, idPool) = CreatePoolNTokens(mnview, "MRA", "MRB");
+    BOOST_REQUIRE(mnview.BuildOwnerShareIndex());
+    const CScript owner(44);
+
+    // block changes of liquidity, without the owner index they are written as before it existed
+    auto addLiquidity = [&](CCustomCSView & view, bool ownerIndex) {
+        auto pool = view.GetPoolPair(idPool);
+        BOOST_REQUIRE(pool);
+        BOOST_REQUIRE(pool->AddLiquidity(10 * COIN, 20 * COIN, [&](CAmount liqAmount) -> Res {
+            BOOST_REQUIRE(view.AddBalance(owner, {idPool, liqAmount}).ok);
+            if (ownerIndex) {
+                return view.SetShare(idPool, owner, 1);
+            }
+            view.WriteBy<CPoolPairView::ByShare>(PoolShareKey{idPool, owner}, uint32_t(1));
+            return Res::Ok();
+        }).ok);
+        BOOST_REQUIRE(view.SetPoolPair(idPool, 1, *pool).ok);
+    };
+    auto removeLiquidity = [&](CCustomCSView & view, bool ownerIndex) {
+        auto pool = view.GetPoolPair(idPool);
+        BOOST_REQUIRE(pool);
+        auto liquidity = view.GetBalance(owner, idPool).nValue;
+        BOOST_REQUIRE(view.SubBalance(owner, {idPool, liquidity}).ok);
+        BOOST_REQUIRE(pool->RemoveLiquidity(liquidity, [&](CAmount amountA, CAmount amountB) -> Res {
+            BOOST_REQUIRE(view.AddBalance(owner, {idA, amountA}).ok);
+            BOOST_REQUIRE(view.AddBalance(owner, {idB, amountB}).ok);
+            if (ownerIndex) {
+                return view.DelShare(idPool, owner);
+            }
+            view.EraseBy<CPoolPairView::ByShare>(PoolShareKey{idPool, owner});
+            return Res::Ok();
+        }).ok);
+        BOOST_REQUIRE(view.SetPoolPair(idPool, 2, *pool).ok);
+    };
+
+    CCustomCSView added(mnview), addedBefore(mnview);
+    addLiquidity(added, true);
+    addLiquidity(addedBefore, false);
+    BOOST_REQUIRE(added.GetShare(idPool, owner));
+    BOOST_CHECK(added.MerkleRoot() != uint256{});
+    BOOST_CHECK(added.MerkleRoot() == addedBefore.MerkleRoot());
+    BOOST_REQUIRE(added.Flush());
+
+    CCustomCSView removed(mnview), removedBefore(mnview);
+    removeLiquidity(removed, true);
+    removeLiquidity(removedBefore, false);
+    BOOST_REQUIRE(!removed.GetShare(idPool, owner));
+    BOOST_CHECK(removed.MerkleRoot() != uint256{});
+    BOOST_CHECK(removed.MerkleRoot() == removedBefore.MerkleRoot());
+}
+
+BOOST_AUTO_TEST_CASE(liquidity_rewards_batch)
+{
+    std::vector<CAmount> liquidity, rewards;
+    constexpr const uint32_t PRECISION = 10000;
+    auto check = [&](CAmount reward, CAmount totalLiquidity) {
+        rewards.resize(liquidity.size());
+        CalculateLiquidityRewards(reward, totalLiquidity, liquidity.data(), rewards.data(), liquidity.size());
+        for (size_t i = 0; i < liquidity.size(); ++i) {
+            BOOST_CHECK_EQUAL(rewards[i], liquidityReward(reward, liquidity[i], totalLiquidity));
+        }
+        // old calculation overflows otherwise
+        if (reward > std::numeric_limits<CAmount>::max() / PRECISION || totalLiquidity > std::numeric_limits<CAmount>::max() / PRECISION) {
+            return;
+        }
+        std::vector<CAmount> shares;
+        std::copy_if(liquidity.begin(), liquidity.end(), std::back_inserter(shares), [&](CAmount value) {
+            return value <= totalLiquidity;
+        });
+        CalculateLiquidityRewards(reward, totalLiquidity, shares.data(), rewards.data(), shares.size(), false);
+        for (size_t i = 0; i < shares.size(); ++i) {
+            uint32_t liqWeight = shares[i] * PRECISION / totalLiquidity;
+            BOOST_CHECK_EQUAL(rewards[i], reward * liqWeight / PRECISION);
+        }
+    };
+
+    // edge values, liquidity over total one gives quotient over 64 bits
+    for (auto totalLiquidity : {CAmount(1), CAmount(3), COIN, MAX_MONEY, CAmount(1) << 62}) {
+        liquidity = {0, 1, totalLiquidity / 2, totalLiquidity - 1, totalLiquidity, MAX_MONEY};
+        for (auto reward : {CAmount(0), CAmount(1), COIN / 2880, 123456789 * COIN, CAmount(1) << 62}) {
+            check(reward, totalLiquidity);
+        }
+    }
+    for (int i = 0; i < 100; ++i) {
+        auto totalLiquidity = CAmount(InsecureRandRange(MAX_MONEY)) + 1;
+        liquidity.clear();
+        for (int j = 0; j < 100; ++j) {
+            liquidity.push_back(CAmount(InsecureRandRange(totalLiquidity + 1)));
+        }
+        check(CAmount(InsecureRandRange(MAX_MONEY)), totalLiquidity);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(owner_rewards_ranges)
+{
+    CCustomCSView mnview(*pcustomcsview);
+    const_cast<int&>(Params().GetConsensus().BayfrontGardensHeight) = 15;
+
+    DCT_ID idA, idB, idPool;
+    std::tie(idA, idB, idPool) = CreatePoolNTokens(mnview, "RA", "RB");
+
+    constexpr const int OwnerCount = 3;
+    CScript owners[OwnerCount];
+    for (int i = 0; i < OwnerCount; ++i) {
+        owners[i] = CScript(1000 + i);
+        BOOST_CHECK(AddPoolLiquidity(mnview, idPool, (i + 1) * COIN, (i + 2) * COIN, owners[i]).ok);
+    }
+
+    // pool state changes at some heights, rewards are constant in between
+    mnview.SetDailyReward(3, 7 * COIN);
+    mnview.SetRewardPct(idPool, 5, COIN / 3);
+    mnview.SetRewardPct(idPool, 20, COIN / 7);
+    for (auto height : {10u, 11u, 30u}) {
+        auto pool = mnview.GetPoolPair(idPool);
+        pool->swapEvent = true;
+        pool->blockCommissionA = height * 1234567;
+        pool->blockCommissionB = height * 7654321;
+        BOOST_REQUIRE(mnview.SetPoolPair(idPool, height, *pool).ok);
+    }
+    {
+        auto pool = mnview.GetPoolPair(idPool);
+        pool->totalLiquidity += COIN;
+        BOOST_REQUIRE(mnview.SetPoolPair(idPool, 25, *pool).ok);
+    }
+    BOOST_REQUIRE(mnview.UpdatePoolPair(idPool, 35, true, -1, {}, CBalances{TAmounts{{idA, COIN}}}).ok);
+    // reward in pool share token changes owner's liquidity every height
+    BOOST_REQUIRE(mnview.UpdatePoolPair(idPool, 40, true, -1, {}, CBalances{TAmounts{{idPool, COIN}}}).ok);
+
+    for (uint32_t targetHeight : {12u, 50u}) {
+        CCustomCSView perHeight(mnview);
+        CCustomCSView ranges(mnview);
+        CCustomCSView batch(mnview);
+        BOOST_CHECK(batch.CalculateOwnerRewards(std::vector<CScript>{owners, owners + OwnerCount}, targetHeight));
+        BOOST_CHECK(!batch.CalculateOwnerRewards(std::vector<CScript>{owners, owners + OwnerCount}, targetHeight));
+        for (const auto& owner : owners) {
+            auto onLiquidity = [&]() -> CAmount {
+                return perHeight.GetBalance(owner, idPool).nValue;
+            };
+            perHeight.CalculatePoolRewards(idPool, onLiquidity, 1, targetHeight,
+                [&](RewardType, CTokenAmount amount, uint32_t) {
+                    perHeight.AddBalance(owner, amount);
+                }
+            );
+            BOOST_CHECK(ranges.CalculateOwnerRewards(owner, targetHeight));
+            for (auto tokenId : {DCT_ID{0}, idA, idB, idPool}) {
+                BOOST_CHECK_EQUAL(perHeight.GetBalance(owner, tokenId).nValue, ranges.GetBalance(owner, tokenId).nValue);
+                BOOST_CHECK_EQUAL(perHeight.GetBalance(owner, tokenId).nValue, batch.GetBalance(owner, tokenId).nValue);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(owner_rewards_history)
+{
+    CCustomCSView mnview(*pcustomcsview);
+    CAccountHistoryStorage history{"reward_history", 1 << 20, true, true};
+    BOOST_REQUIRE(history.HasRewardHistory());
+
+    DCT_ID idA, idB, idPool;
+    std::tie(idA, idB, idPool) = CreatePoolNTokens(mnview, "HRA", "HRB");
+    const CScript owners[] = {CScript(2000), CScript(2001)};
+    for (const auto& owner : owners) {
+        BOOST_REQUIRE(AddPoolLiquidity(mnview, idPool, 3 * COIN, 5 * COIN, owner).ok);
+    }
+    mnview.SetDailyReward(3, 7 * COIN);
+    mnview.SetRewardPct(idPool, 5, COIN / 3);
+    {
+        auto pool = mnview.GetPoolPair(idPool);
+        pool->swapEvent = true;
+        pool->blockCommissionA = 1234567;
+        pool->blockCommissionB = 7654321;
+        BOOST_REQUIRE(mnview.SetPoolPair(idPool, 10, *pool).ok);
+    }
+
+    using Row = std::tuple<uint32_t, uint8_t, uint32_t, CAmount>;
+    constexpr const uint32_t targetHeight = 20;
+    auto expectedRows = [&](CScript const & owner) {
+        std::vector<Row> rows;
+        CCustomCSView view(mnview);
+        auto onLiquidity = [&]() -> CAmount {
+            return view.GetBalance(owner, idPool).nValue;
+        };
+        view.CalculatePoolRewards(idPool, onLiquidity, 1, targetHeight, [&](RewardType type, CTokenAmount amount, uint32_t height) {
+            rows.emplace_back(height, uint8_t(type), amount.nTokenId.v, amount.nValue);
+        });
+        std::sort(rows.begin(), rows.end());
+        return rows;
+    };
+    auto historyRows = [&](CScript const & owner) {
+        std::vector<Row> rows;
+        history.ForEachRewardHistory(owner, [&](uint32_t endHeight, DCT_ID const & poolId, CLazySerialize<RewardHistoryValue> value) {
+            BOOST_CHECK_EQUAL(endHeight, targetHeight);
+            BOOST_CHECK(poolId == idPool);
+            for (const auto& range : value.get()) {
+                for (auto height = range.begin; height < range.end; ++height) {
+                    rows.emplace_back(height, range.type, range.amount.nTokenId.v, range.amount.nValue);
+                }
+            }
+            return true;
+        });
+        std::sort(rows.begin(), rows.end());
+        return rows;
+    };
+
+    // single and batch settlement are recorded alike
+    {
+        CRewardsHistoryWriter cache(mnview, targetHeight, &history);
+        BOOST_CHECK(cache.CalculateOwnerRewards(owners[0], targetHeight));
+        BOOST_CHECK(cache.CalculateOwnerRewards(std::vector<CScript>{owners[1]}, targetHeight));
+        BOOST_REQUIRE(cache.Flush());
+        BOOST_REQUIRE(history.Flush());
+    }
+    for (const auto& owner : owners) {
+        auto rows = historyRows(owner);
+        BOOST_CHECK(!rows.empty());
+        BOOST_CHECK(rows == expectedRows(owner));
+    }
+
+    // block disconnection
+    history.EraseRewardHistory(targetHeight);
+    BOOST_REQUIRE(history.Flush());
+    for (const auto& owner : owners) {
+        BOOST_CHECK(historyRows(owner).empty());
+    }
+
+    // pools pay every block before Eunos, the payouts are replayed by readers instead
+    {
+        CRewardsHistoryWriter cache(mnview, targetHeight, &history);
+        BOOST_CHECK(cache.UpdatePoolRewards([&](CScript const & owner, DCT_ID tokenId) {
+            return cache.GetBalance(owner, tokenId);
+        }, [&](CScript const &, CScript const & to, CTokenAmount amount) {
+            return to.empty() ? Res::Ok() : cache.AddBalance(to, amount);
+        }, targetHeight) > 0);
+        BOOST_REQUIRE(cache.Flush());
+        BOOST_REQUIRE(history.Flush());
+    }
+    for (const auto& owner : owners) {
+        BOOST_CHECK(historyRows(owner).empty());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pool_providers_registry)
+{
+    CCustomCSView mnview(*pcustomcsview);
+
+    DCT_ID idA, idB, idPool;
+    std::tie(idA, idB, idPool) = CreatePoolNTokens(mnview, "A", "B");
+    const CScript first(1), second(2), third(3);
+    BOOST_REQUIRE(AddPoolLiquidity(mnview, idPool, 10*COIN, 10*COIN, first).ok);
+    BOOST_REQUIRE(AddPoolLiquidity(mnview, idPool, 20*COIN, 20*COIN, second).ok);
+
+    CPoolProvidersRegistry registry;
+    registry.ApplyChanges(mnview); // not loaded yet
+    BOOST_CHECK(!registry.IsLoaded());
+    registry.Load(mnview);
+    BOOST_CHECK_EQUAL(registry.GetProvidersCount(idPool), 2);
+
+    // block changes: new provider, the first leaves, the second adds liquidity
+    {
+        CCustomCSView cache(mnview);
+        BOOST_REQUIRE(AddPoolLiquidity(cache, idPool, 5*COIN, 5*COIN, third).ok);
+        BOOST_REQUIRE(cache.SubBalance(first, {idPool, cache.GetBalance(first, idPool).nValue}).ok);
+        BOOST_REQUIRE(cache.DelShare(idPool, first).ok);
+        BOOST_REQUIRE(cache.AddBalance(second, {idPool, COIN}).ok);
+        BOOST_REQUIRE(cache.AddBalance(first, {idA, COIN}).ok);
+        registry.ApplyChanges(cache);
+        cache.Flush();
+    }
+
+    CPoolProvidersRegistry loaded;
+    loaded.Load(mnview);
+    for (auto reg : {&registry, &loaded}) {
+        BOOST_CHECK_EQUAL(reg->GetProvidersCount(idPool), 2);
+        BOOST_CHECK_EQUAL(reg->GetProvidersCount(idA), 0);
+        auto top = reg->GetTopProviders(idPool, 5);
+        BOOST_REQUIRE_EQUAL(top.size(), 2);
+        BOOST_CHECK(top[0].first == second);
+        BOOST_CHECK_EQUAL(top[0].second, mnview.GetBalance(second, idPool).nValue);
+        BOOST_CHECK(top[1].first == third);
+        BOOST_CHECK_EQUAL(top[1].second, mnview.GetBalance(third, idPool).nValue);
+        BOOST_CHECK_EQUAL(reg->GetTopProviders(idPool, 1).size(), 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pool_swap_graph)
+{
+    CCustomCSView mnview(*pcustomcsview);
+
+    DCT_ID idX = CreateToken(mnview, "GX");
+    DCT_ID idY = CreateToken(mnview, "GY");
+    DCT_ID idZ = CreateToken(mnview, "GZ");
+    auto createPool = [&](DCT_ID idA, DCT_ID idB, CAmount reserveA, CAmount reserveB) {
+        DCT_ID idPool = CreateToken(mnview, "G" + idA.ToString() + "-" + idB.ToString(), (uint8_t)CToken::TokenFlags::Default | (uint8_t)CToken::TokenFlags::DAT | (uint8_t)CToken::TokenFlags::LPS);
+        CPoolPair pool{};
+        pool.idTokenA = idA;
+        pool.idTokenB = idB;
+        pool.commission = 2000000; // 2%
+        pool.status = true;
+        BOOST_REQUIRE(mnview.SetPoolPair(idPool, 1, pool).ok);
+        pool.reserveA = reserveA;
+        pool.reserveB = reserveB;
+        pool.totalLiquidity = COIN;
+        BOOST_REQUIRE(mnview.SetPoolPair(idPool, 1, pool).ok);
+        return idPool;
+    };
+    auto poolXY = createPool(idX, idY, 1000 * COIN, 2000 * COIN);
+    auto poolYZ = createPool(idY, idZ, 3000 * COIN, 1000 * COIN);
+    auto poolXZ = createPool(idX, idZ, 10 * COIN, 10 * COIN);
+
+    const int height = 100;
+    CPoolSwapGraph graph(mnview, height);
+
+    auto swap = [&](CTokenAmount in, std::vector<DCT_ID> const & path) {
+        for (const auto& poolId : path) {
+            auto pool = mnview.GetPoolPair(poolId);
+            BOOST_REQUIRE(pool->Swap(in, PoolPrice{INT64_MAX, INT64_MAX}, [&](CTokenAmount const & out) {
+                in = out;
+                return Res::Ok();
+            }, height).ok);
+        }
+        return in;
+    };
+
+    for (auto amount : {COIN / 100, 5 * COIN}) {
+        CTokenAmount in{idX, amount};
+        auto viaY = swap(in, {poolXY, poolYZ});
+        auto direct = swap(in, {poolXZ});
+        BOOST_CHECK_EQUAL(graph.Swap(in, {poolXY, poolYZ}).val->nValue, viaY.nValue);
+        BOOST_CHECK_EQUAL(graph.Swap(in, {poolXZ}).val->nValue, direct.nValue);
+
+        auto best = graph.FindBestPath(in, idZ);
+        BOOST_REQUIRE(best.ok);
+        BOOST_CHECK(best.val->amount.nTokenId == idZ);
+        BOOST_CHECK_EQUAL(best.val->amount.nValue, std::max(viaY.nValue, direct.nValue));
+        BOOST_CHECK_EQUAL(best.val->pools.size(), viaY.nValue > direct.nValue ? 2 : 1);
+    }
+    // the same pool twice sees reserves changed by the first swap
+    auto backAndForth = graph.Swap({idX, COIN}, {poolXY, poolXY});
+    BOOST_REQUIRE(backAndForth.ok);
+    BOOST_CHECK(backAndForth.val->nTokenId == idX);
+    BOOST_CHECK(backAndForth.val->nValue < COIN);
+
+    // single pool quotes
+    BOOST_REQUIRE(graph.GetPoolId(idZ, idY));
+    BOOST_CHECK(*graph.GetPoolId(idZ, idY) == poolYZ);
+    BOOST_CHECK(!graph.GetPoolId(idX, poolXY));
+    BOOST_CHECK_EQUAL(graph.SwapPool({idY, COIN}, poolYZ).val->nValue, swap({idY, COIN}, {poolYZ}).nValue);
+    BOOST_CHECK(!graph.SwapPool({idY, COIN}, poolYZ, PoolPrice{0, 1}).ok);
+
+    BOOST_CHECK(!graph.FindBestPath({idX, COIN}, idZ, 0).ok);
+    BOOST_CHECK(!graph.Swap({idZ, COIN}, {poolXY}).ok);
+
+    // shared graph is rebuilt only when the block is changed
+    auto shared = GetPoolSwapGraph(uint256S("01"), mnview, height);
+    BOOST_CHECK(GetPoolSwapGraph(uint256S("01"), mnview, height) == shared);
+    BOOST_CHECK(GetPoolSwapGraph(uint256S("02"), mnview, height) != shared);
+    ResetPoolSwapGraph();
+}
+
+BOOST_AUTO_TEST_CASE(pool_history_index)
+{
+    CCustomCSView mnview(*pcustomcsview);
+    CPoolHistoryStorage history{"pool_history", 1 << 20, true, true};
+
+    DCT_ID idA, idB, idPool;
+    std::tie(idA, idB, idPool) = CreatePoolNTokens(mnview, "HA", "HB");
+    BOOST_REQUIRE(AddPoolLiquidity(mnview, idPool, 100 * COIN, 200 * COIN, CScript(1)).ok);
+
+    auto readHistory = [&](uint32_t height) {
+        std::vector<std::pair<uint32_t, PoolHistoryValue>> records;
+        history.ForEachPoolHistory(idPool, [&](uint32_t recordHeight, PoolHistoryValue const & value) {
+            records.emplace_back(recordHeight, value);
+            return true;
+        }, height);
+        return records;
+    };
+
+    history.WriteBlockHistory(mnview, 10, {});
+    BOOST_REQUIRE(history.Flush());
+    // unchanged pool isn't recorded
+    history.WriteBlockHistory(mnview, 11, {});
+    BOOST_REQUIRE(history.Flush());
+
+    auto pool = mnview.GetPoolPair(idPool);
+    BOOST_REQUIRE(pool->Swap({idA, COIN}, PoolPrice{INT64_MAX, INT64_MAX}, [&](CTokenAmount const &) {
+        return mnview.SetPoolPair(idPool, 12, *pool);
+    }, 12).ok);
+    PoolSwapVolumes volumes;
+    volumes[idPool] = {COIN, 0};
+    history.WriteBlockHistory(mnview, 12, volumes);
+    BOOST_REQUIRE(history.Flush());
+
+    auto records = readHistory(UINT_MAX);
+    BOOST_REQUIRE_EQUAL(records.size(), 2);
+    BOOST_CHECK_EQUAL(records[0].first, 12);
+    BOOST_CHECK_EQUAL(records[0].second.reserveA, pool->reserveA);
+    BOOST_CHECK_EQUAL(records[0].second.reserveB, pool->reserveB);
+    BOOST_CHECK_EQUAL(records[0].second.volumeA, COIN);
+    BOOST_CHECK_EQUAL(records[0].second.volumeB, 0);
+    BOOST_CHECK_EQUAL(records[1].first, 10);
+    BOOST_CHECK_EQUAL(records[1].second.reserveA, 100 * COIN);
+    BOOST_CHECK_EQUAL(records[1].second.totalLiquidity, pool->totalLiquidity);
+
+    records = readHistory(11);
+    BOOST_REQUIRE_EQUAL(records.size(), 1);
+    BOOST_CHECK_EQUAL(records[0].first, 10);
+
+    // block disconnection
+    history.EraseBlockHistory(mnview, 12);
+    BOOST_REQUIRE(history.Flush());
+    BOOST_CHECK_EQUAL(readHistory(UINT_MAX).size(), 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
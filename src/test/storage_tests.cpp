@@ -66,7 +66,7 @@ std::map<TBytes, TBytes> TakeSnapshot(CStorageKV const & storage)
     for(it->Seek(key); it->Valid(); it->Next()) {
         boost::this_thread::interruption_point();
 
-        result.emplace(it->Key(),it->Value());
+        result.emplace(ToBytes(it->Key()), ToBytes(it->Value()));
     }
     return result;
 }
@@ -446,4 +446,421 @@ BOOST_AUTO_TEST_CASE(LowerBoundTest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(PrefixIteratorTest)
+{
+    CStorageLevelDB db{"prefix_iterator", 1 << 20, true, true};
+    CFlushableStorageKV tip(db);
+    CFlushableStorageKV view(static_cast<CStorageKV&>(tip));
+    std::map<TBytes, TBytes> expected;
+
+    // random layout of three tables over all layers
+    for (CStorageKV* layer : std::vector<CStorageKV*>{&db, &tip, &view}) {
+        for (int i = 0; i < 200; ++i) {
+            TBytes key{uint8_t('a' + InsecureRandRange(3)), uint8_t(InsecureRandRange(64))};
+            if (InsecureRandBool()) {
+                TBytes value{uint8_t(i)};
+                layer->Write(key, value);
+                expected[key] = value;
+            } else {
+                layer->Erase(key);
+                expected.erase(key);
+            }
+        }
+        layer->Flush();
+    }
+    db.Flush();
+    for (int i = 0; i < 200; ++i) {
+        TBytes key{uint8_t('a' + InsecureRandRange(3)), uint8_t(InsecureRandRange(64))};
+        view.Write(key, key);
+        expected[key] = key;
+    }
+
+    const TBytes prefix{'b'};
+    std::vector<TBytes> keys;
+    for (const auto& kv : expected) {
+        if (kv.first[0] == prefix[0]) {
+            keys.push_back(kv.first);
+        }
+    }
+    BOOST_REQUIRE(!keys.empty());
+
+    auto it = view.NewIterator(prefix);
+    it->Seek(TBytes{});
+    for (const auto& key : keys) {
+        BOOST_REQUIRE(it->Valid());
+        BOOST_CHECK(ToBytes(it->Key()) == key);
+        BOOST_CHECK(ToBytes(it->Value()) == expected[key]);
+        it->Next();
+    }
+    BOOST_CHECK(!it->Valid());
+
+    // walk back from the end, step out of the range and return
+    for (int round = 0; round < 2; ++round) {
+        for (auto key = keys.rbegin(); key != keys.rend(); ++key) {
+            it->Prev();
+            BOOST_REQUIRE(it->Valid());
+            BOOST_CHECK(ToBytes(it->Key()) == *key);
+        }
+        it->Prev();
+        BOOST_CHECK(!it->Valid());
+        it->Prev();
+        BOOST_CHECK(!it->Valid());
+        for (const auto& key : keys) {
+            it->Next();
+            BOOST_REQUIRE(it->Valid());
+            BOOST_CHECK(ToBytes(it->Key()) == key);
+        }
+        it->Next();
+        BOOST_CHECK(!it->Valid());
+    }
+
+    // random walk from a random position
+    for (int i = 0; i < 100; ++i) {
+        auto pos = InsecureRandRange(keys.size());
+        it->Seek(keys[pos]);
+        for (int step = 0; step < 20 && it->Valid(); ++step) {
+            BOOST_CHECK(ToBytes(it->Key()) == keys[pos]);
+            if (InsecureRandBool()) {
+                it->Next();
+                BOOST_CHECK_EQUAL(it->Valid(), ++pos < keys.size());
+            } else {
+                it->Prev();
+                BOOST_CHECK_EQUAL(it->Valid(), pos-- > 0);
+            }
+        }
+    }
+
+    // key only scan doesn't leave the table
+    CCustomCSView mnview(*pcustomcsview);
+    mnview.WriteBy<TestForward>(TestForward{1}, 1);
+    mnview.WriteBy<TestForward>(TestForward{2}, 2);
+    mnview.WriteBy<TestBackward>(TestBackward{3}, 3);
+    std::vector<uint32_t> ids;
+    mnview.ForEachKey<TestForward, TestForward>([&](TestForward const & key) {
+        ids.push_back(key.n);
+        return true;
+    });
+    BOOST_CHECK(ids == std::vector<uint32_t>({1, 2}));
+}
+
+BOOST_AUTO_TEST_CASE(WriteBufferTest)
+{
+    CStorageWriteBuffer buffer;
+    buffer.Write(ToBytes("key2"), ToBytes("long value"));
+    buffer.Write(ToBytes("key1"), ToBytes("value1"));
+    buffer.Erase(ToBytes("key3"));
+    BOOST_CHECK_EQUAL(buffer.size(), 3u);
+
+    // sorted as TBytes
+    auto it = buffer.begin();
+    BOOST_CHECK(ToBytes(it->first) == ToBytes("key1"));
+    BOOST_CHECK(ToBytes(*(++it)->second) == ToBytes("long value"));
+    BOOST_CHECK(!(++it)->second);
+
+    // shorter value reuses its slot, longer one is appended
+    buffer.Write(ToBytes("key2"), ToBytes("short"));
+    BOOST_CHECK(ToBytes(*buffer.find(ToBytes("key2"))->second) == ToBytes("short"));
+    buffer.Write(ToBytes("key2"), ToBytes("very long value"));
+    BOOST_CHECK(ToBytes(*buffer.find(ToBytes("key2"))->second) == ToBytes("very long value"));
+    buffer.Erase(ToBytes("key1"));
+    BOOST_CHECK(!buffer.find(ToBytes("key1"))->second);
+    BOOST_CHECK_EQUAL(buffer.size(), 3u);
+    BOOST_CHECK_EQUAL(buffer.GetArena().Chunks(), 1u);
+
+    // oversized values don't waste the current chunk
+    buffer.Write(ToBytes("key4"), TBytes(CStorageArena::MaxChunkSize));
+    BOOST_CHECK_EQUAL(buffer.GetArena().Chunks(), 2u);
+    buffer.Write(ToBytes("key5"), ToBytes("value5"));
+    BOOST_CHECK_EQUAL(buffer.GetArena().Chunks(), 2u);
+    BOOST_CHECK(buffer.DynamicUsage() > CStorageArena::MaxChunkSize);
+
+    buffer.Clear();
+    BOOST_CHECK(buffer.empty());
+    BOOST_CHECK(buffer.DynamicUsage() < CStorageArena::MinChunkSize);
+}
+
+BOOST_AUTO_TEST_CASE(KeyFilterTest)
+{
+    CStorageWriteBuffer buffer;
+    const auto& filter = buffer.GetFilter();
+    uint32_t n = 0;
+    for (; n + 1 < CStorageWriteBuffer::MinFilterKeys; ++n) {
+        buffer.Write(DbTypeToBytes(n), {});
+    }
+    BOOST_CHECK(!filter.Active());
+    for (; n < 10 * CStorageWriteBuffer::MinFilterKeys; ++n) {
+        n % 2 ? buffer.Write(DbTypeToBytes(n), {}) : buffer.Erase(DbTypeToBytes(n));
+    }
+    BOOST_CHECK(filter.Active());
+    BOOST_CHECK(filter.Capacity() >= buffer.size());
+
+    // no false negatives, few false positives
+    uint32_t positives = 0;
+    for (uint32_t i = 0; i < 2 * n; ++i) {
+        auto key = DbTypeToBytes(i);
+        BOOST_CHECK_EQUAL(buffer.find(key) != buffer.end(), i < n);
+        positives += filter.MayContain(MakeView(key));
+    }
+    BOOST_CHECK(positives - n < n / 20);
+
+    buffer.Clear();
+    BOOST_CHECK(!filter.Active());
+}
+
+BOOST_AUTO_TEST_CASE(ReadCacheTest)
+{
+    CStorageLevelDB db{"read_cache", 1 << 20, true, true, 16 << 10};
+    const auto& cache = db.GetReadCache();
+    TBytes value;
+    db.Write(ToBytes("key1"), ToBytes("value1"));
+    db.Flush();
+
+    // hits and misses are cached
+    BOOST_CHECK(db.Read(ToBytes("key1"), value) && value == ToBytes("value1"));
+    BOOST_CHECK(!db.Exists(ToBytes("key2")));
+    BOOST_CHECK(!db.Read(ToBytes("key2"), value));
+    auto usage = cache.DynamicUsage();
+    BOOST_CHECK(usage > 0);
+    BOOST_CHECK(db.Read(ToBytes("key1"), value) && value == ToBytes("value1"));
+    BOOST_CHECK_EQUAL(cache.DynamicUsage(), usage);
+
+    // not filled while batch is pending
+    db.Write(ToBytes("key1"), ToBytes("value2"));
+    db.Write(ToBytes("key2"), ToBytes("value2"));
+    BOOST_CHECK(cache.DynamicUsage() == 0);
+    BOOST_CHECK(db.Read(ToBytes("key1"), value) && value == ToBytes("value1"));
+    BOOST_CHECK(cache.DynamicUsage() == 0);
+    db.Flush();
+    BOOST_CHECK(db.Read(ToBytes("key1"), value) && value == ToBytes("value2"));
+    BOOST_CHECK(db.Exists(ToBytes("key2")));
+
+    db.Erase(ToBytes("key1"));
+    db.Discard();
+    BOOST_CHECK(db.Read(ToBytes("key1"), value) && value == ToBytes("value2"));
+    db.Erase(ToBytes("key1"));
+    db.Flush();
+    BOOST_CHECK(!db.Exists(ToBytes("key1")));
+
+    // least recently used are evicted
+    for (int i = 0; i < 1000; ++i) {
+        db.Read(DbTypeToBytes(i), value);
+        BOOST_CHECK(cache.DynamicUsage() <= cache.MaxSize());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(EntryHashesTest)
+{
+    CStorageWriteBuffer buffer;
+    auto expected = [&]() {
+        std::vector<uint256> hashes;
+        for (const auto& it : buffer) {
+            hashes.push_back(Hash2(ToBytes(it.first), it.second ? ToBytes(*it.second) : TBytes{}));
+        }
+        return hashes;
+    };
+    for (uint32_t i = 0; i < 3 * CStorageWriteBuffer::MinHashesPerThread; ++i) {
+        buffer.Write(DbTypeToBytes(i), DbTypeToBytes(i * i));
+    }
+    BOOST_CHECK(buffer.EntryHashes() == expected());
+
+    // cached hashes are dropped on change
+    buffer.Write(DbTypeToBytes(uint32_t(1)), ToBytes("changed"));
+    buffer.Erase(DbTypeToBytes(uint32_t(2)));
+    buffer.Erase(ToBytes("erased"));
+    buffer.Write(ToBytes("new"), ToBytes("value"));
+    BOOST_CHECK(buffer.EntryHashes() == expected());
+    BOOST_CHECK(buffer.EntryHashes() == expected());
+
+    buffer.Clear();
+    BOOST_CHECK(buffer.EntryHashes().empty());
+}
+
+BOOST_AUTO_TEST_CASE(AsyncFlushTest)
+{
+    CStorageLevelDB db{"async_flush", 1 << 20, true, true, 16 << 10};
+    db.Write(ToBytes("key1"), ToBytes("value1"));
+    db.Write(ToBytes("key2"), ToBytes("value2"));
+    db.Flush();
+
+    CFlushableStorageKV view(db);
+    view.Write(ToBytes("key1"), ToBytes("changed"));
+    view.Erase(ToBytes("key2"));
+    view.Write(ToBytes("key3"), ToBytes("value3"));
+    BOOST_CHECK(db.FlushAsync(view.Detach()));
+    BOOST_CHECK(view.GetRaw().empty());
+
+    // changes are visible while written
+    TBytes value;
+    BOOST_CHECK(view.Read(ToBytes("key1"), value) && value == ToBytes("changed"));
+    BOOST_CHECK(!view.Exists(ToBytes("key2")));
+    BOOST_CHECK(view.Read(ToBytes("key3"), value) && value == ToBytes("value3"));
+    std::vector<TBytes> keys;
+    for (auto it = view.NewIterator(); it->Valid(); it->Next()) {
+        keys.push_back(ToBytes(it->Key()));
+    }
+    BOOST_CHECK(keys == std::vector<TBytes>({ToBytes("key1"), ToBytes("key3")}));
+
+    // next layer goes after
+    view.Write(ToBytes("key3"), ToBytes("next"));
+    BOOST_CHECK(db.FlushAsync(view.Detach()));
+    BOOST_CHECK(db.WaitAsync());
+    BOOST_CHECK(db.SizeEstimate() == 0);
+    BOOST_CHECK(db.Read(ToBytes("key1"), value) && value == ToBytes("changed"));
+    BOOST_CHECK(!db.Exists(ToBytes("key2")));
+    BOOST_CHECK(db.Read(ToBytes("key3"), value) && value == ToBytes("next"));
+}
+
+BOOST_AUTO_TEST_CASE(CompactionQueueTest)
+{
+    CStorageCompactionQueue::Ranges ranges;
+    for (auto key : {"a3", "b1", "a1", "c5", "a2"}) {
+        CStorageCompactionQueue::AddKey(ranges, ToBytes(key));
+    }
+    BOOST_CHECK_EQUAL(ranges.size(), 3);
+    BOOST_CHECK(ranges['a'] == std::make_pair(ToBytes("a1"), ToBytes("a3")));
+
+    // ranges of a table are merged
+    CStorageCompactionQueue queue;
+    queue.Push(ranges);
+    ranges.clear();
+    CStorageCompactionQueue::AddKey(ranges, ToBytes("b0"));
+    CStorageCompactionQueue::AddKey(ranges, ToBytes("b2"));
+    queue.Push(ranges);
+    auto stats = queue.GetStats();
+    BOOST_CHECK_EQUAL(stats.added, 4);
+    BOOST_CHECK_EQUAL(stats.pending, 3);
+
+    // tables are taken in turn
+    CStorageCompactionQueue::Range range;
+    BOOST_CHECK(queue.Pop(range) && range == std::make_pair(ToBytes("a1"), ToBytes("a3")));
+    queue.Push({{'a', {ToBytes("a5"), ToBytes("a6")}}});
+    BOOST_CHECK(queue.Pop(range) && range == std::make_pair(ToBytes("b0"), ToBytes("b2")));
+    BOOST_CHECK(queue.Pop(range) && range == std::make_pair(ToBytes("c5"), ToBytes("c5")));
+    BOOST_CHECK(queue.Pop(range) && range == std::make_pair(ToBytes("a5"), ToBytes("a6")));
+    BOOST_CHECK(!queue.Pop(range));
+
+    // flush leaves erased ranges to compaction
+    CStorageLevelDB db{"compaction", 1 << 20, true, true};
+    auto key = [](int i) {
+        return DbTypeToBytes(std::make_pair('t', i));
+    };
+    for (int i = 0; i < 100; ++i) {
+        db.Write(key(i), DbTypeToBytes(i));
+    }
+    db.Flush();
+    db.Erase(key(10));
+    db.Erase(key(20));
+    db.Discard();
+    BOOST_CHECK_EQUAL(db.GetCompactionStats().added, 0);
+    db.Erase(key(10));
+    db.Erase(key(20));
+    db.Flush();
+    BOOST_CHECK_EQUAL(db.GetCompactionStats().pending, 1);
+    BOOST_CHECK_EQUAL(db.Compact(2), 1);
+    stats = db.GetCompactionStats();
+    BOOST_CHECK_EQUAL(stats.compacted, 1);
+    BOOST_CHECK_EQUAL(stats.pending, 0);
+    BOOST_CHECK(db.Exists(key(15)) && !db.Exists(key(20)));
+}
+
+BOOST_AUTO_TEST_CASE(TableGroupsTest)
+{
+    std::vector<CStorageTableGroup> groups{{"ab", {'a', 'b'}, {}, 20}, {"d", {'d'}, {}, 20}};
+    CStorageLevelDB db{"table_groups", 1 << 20, true, true, 0, groups};
+    BOOST_CHECK(db.IsEmpty() && db.IsConsistent());
+
+    std::vector<TBytes> keys;
+    for (unsigned char table : {'a', 'b', 'c', 'd', 'e'}) {
+        for (unsigned char i = 0; i < 10; ++i) {
+            keys.push_back({table, i});
+            db.Write(keys.back(), DbTypeToBytes(i));
+        }
+    }
+    BOOST_CHECK(db.Flush());
+    BOOST_CHECK(!db.IsEmpty() && db.IsConsistent());
+
+    // tables of all instances are iterated in key order, flush counter is not seen
+    auto collect = [&](const TBytes& prefix) {
+        std::vector<TBytes> result;
+        auto it = db.NewIterator(prefix);
+        for (it->Seek(prefix); it->Valid(); it->Next()) {
+            result.push_back(ToBytes(it->Key()));
+        }
+        std::vector<TBytes> reversed;
+        for (it->Prev(); it->Valid(); it->Prev()) {
+            reversed.insert(reversed.begin(), ToBytes(it->Key()));
+        }
+        BOOST_CHECK(reversed == result);
+        return result;
+    };
+    BOOST_CHECK(collect({}) == keys);
+    BOOST_CHECK(collect({'d'}) == std::vector<TBytes>(keys.begin() + 30, keys.begin() + 40));
+
+    TBytes value;
+    db.Erase({'a', 0});
+    db.Erase({'d', 9});
+    BOOST_CHECK(db.Flush());
+    BOOST_CHECK(!db.Exists({'a', 0}) && !db.Exists({'d', 9}));
+    BOOST_CHECK(db.Read({'b', 1}, value) && value == DbTypeToBytes((unsigned char)1));
+    BOOST_CHECK_EQUAL(db.GetCompactionStats().pending, 2);
+    BOOST_CHECK_EQUAL(db.Compact(2), 2);
+
+    // background write goes to every instance
+    CFlushableStorageKV view(db);
+    view.Write({'d', 20}, ToBytes("async"));
+    view.Erase({'b', 0});
+    BOOST_CHECK(db.FlushAsync(view.Detach()));
+    BOOST_CHECK_EQUAL(collect({}).size(), 48);
+    BOOST_CHECK(db.WaitAsync());
+    BOOST_CHECK(db.IsConsistent());
+    BOOST_CHECK(db.Read({'d', 20}, value) && value == ToBytes("async"));
+    BOOST_CHECK_EQUAL(collect({}).size(), 48);
+}
+
+BOOST_AUTO_TEST_CASE(SnapshotTest)
+{
+    CStorageLevelDB db{"snapshot", 1 << 20, true, true, 16 << 10};
+    CFlushableStorageKV view(db);
+    view.Write(ToBytes("key1"), ToBytes("disk"));
+    view.Write(ToBytes("key2"), ToBytes("disk"));
+    view.Flush();
+    db.Flush();
+    view.Write(ToBytes("key2"), ToBytes("memory"));
+    view.Write(ToBytes("key3"), ToBytes("memory"));
+
+    auto snapshot = db.Snapshot(view.GetRaw(), uint256S("01"));
+    BOOST_CHECK(db.Snapshot(view.GetRaw(), uint256S("01")) == snapshot);
+
+    // later writes are not seen
+    view.Erase(ToBytes("key1"));
+    view.Write(ToBytes("key3"), ToBytes("changed"));
+    view.Flush();
+    db.Flush();
+    TBytes value;
+    BOOST_CHECK(!db.Exists(ToBytes("key1")));
+    BOOST_CHECK(snapshot->Read(ToBytes("key1"), value) && value == ToBytes("disk"));
+    BOOST_CHECK(snapshot->Read(ToBytes("key2"), value) && value == ToBytes("memory"));
+    BOOST_CHECK(snapshot->Read(ToBytes("key3"), value) && value == ToBytes("memory"));
+    std::vector<TBytes> values;
+    auto it = snapshot->NewIterator();
+    for (it->Seek({}); it->Valid(); it->Next()) {
+        values.push_back(ToBytes(it->Value()));
+    }
+    BOOST_CHECK(values == std::vector<TBytes>({ToBytes("disk"), ToBytes("memory"), ToBytes("memory")}));
+
+    // it's a base of read-only view
+    CFlushableStorageKV reader(*snapshot);
+    reader.Write(ToBytes("key4"), ToBytes("reader"));
+    BOOST_CHECK(reader.Exists(ToBytes("key4")) && !snapshot->Exists(ToBytes("key4")));
+    BOOST_CHECK(!snapshot->Write(ToBytes("key4"), ToBytes("reader")));
+
+    // background write is seen by new snapshot
+    view.Write(ToBytes("key5"), ToBytes("async"));
+    BOOST_CHECK(db.FlushAsync(view.Detach()));
+    auto next = db.Snapshot(view.GetRaw(), uint256S("02"));
+    BOOST_CHECK(db.WaitAsync());
+    BOOST_CHECK(next->Read(ToBytes("key5"), value) && value == ToBytes("async"));
+    BOOST_CHECK(!next->Exists(ToBytes("key1")));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
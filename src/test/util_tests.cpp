@@ -9,6 +9,7 @@
 #include <test/setup_common.h>
 #include <test/util.h>
 #include <util/moneystr.h>
+#include <util/parallel.h>
 #include <util/strencodings.h>
 #include <util/string.h>
 #include <util/time.h>
@@ -1572,4 +1573,24 @@ BOOST_AUTO_TEST_CASE(test_Capitalize)
     BOOST_CHECK_EQUAL(Capitalize("\x00\xfe\xff"), "\x00\xfe\xff");
 }
 
+BOOST_AUTO_TEST_CASE(test_ParallelFor)
+{
+    std::vector<int> items(1000);
+    ParallelFor(items.size(), 1, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            items[i] += int(i);
+        }
+    });
+    for (size_t i = 0; i < items.size(); ++i) {
+        BOOST_CHECK_EQUAL(items[i], int(i));
+    }
+
+    // worker exceptions reach the caller
+    BOOST_CHECK_THROW(ParallelFor(items.size(), 1, [&](size_t begin, size_t end) {
+        if (end == items.size()) {
+            throw std::runtime_error("last part");
+        }
+    }), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
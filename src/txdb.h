@@ -41,6 +41,12 @@ static const int64_t nMaxTxIndexCache = 1024;
 static const int64_t max_filter_index_cache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! -customcache default (MiB)
+static const int64_t nDefaultCustomCache = 64;
+//! max. -customcache (MiB)
+static const int64_t nMaxCustomCache = sizeof(void*) > 4 ? 16384 : 256;
+//! -customcompactinterval default (seconds)
+static const int64_t nDefaultCustomCompactInterval = 10;
 
 /** CCoinsView backed by the coin database (chainstate/) */
 class CCoinsViewDB final : public CCoinsView
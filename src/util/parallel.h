@@ -0,0 +1,56 @@
+// Copyright (c) DeFi Blockchain Developers
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DEFI_UTIL_PARALLEL_H
+#define DEFI_UTIL_PARALLEL_H
+
+#include <util/system.h>
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+/**
+ * Call func(begin, end) on contiguous parts of [0, count), each in its own thread.
+ * The calling thread takes the first part. Threads are not started unless every
+ * one of them gets at least minPerThread items, so small inputs run inline.
+ * An exception thrown by func is rethrown after all parts are done, the one of
+ * the lowest part if several threw.
+ */
+template<typename Func>
+void ParallelFor(size_t count, size_t minPerThread, Func&& func)
+{
+    auto threads = std::min(size_t(std::max(GetNumCores(), 1)), count / std::max(minPerThread, size_t(1)));
+    if (threads < 2) {
+        func(size_t(0), count);
+        return;
+    }
+    auto chunk = (count + threads - 1) / threads;
+    std::vector<std::exception_ptr> errors((count + chunk - 1) / chunk);
+    auto run = [&func, &errors, chunk](size_t begin, size_t end) {
+        try {
+            func(begin, end);
+        } catch (...) {
+            errors[begin / chunk] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (auto begin = chunk; begin < count; begin += chunk) {
+        auto end = std::min(begin + chunk, count);
+        workers.emplace_back([&run, begin, end] { run(begin, end); });
+    }
+    run(size_t(0), chunk);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+#endif // DEFI_UTIL_PARALLEL_H
@@ -24,6 +24,8 @@
 #include <masternodes/govvariables/lp_daily_dfi_reward.h>
 #include <masternodes/masternodes.h>
 #include <masternodes/mn_checks.h>
+#include <masternodes/poolhistory.h>
+#include <masternodes/poolproviders.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
@@ -134,6 +136,7 @@ bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
 size_t nCoinCacheUsage = 5000 * 300;
 size_t nCustomMemUsage = nDefaultDbCache << 10;
+bool fCustomAsyncFlush = DEFAULT_CUSTOM_ASYNC_FLUSH;
 uint64_t nPruneTarget = 0;
 bool fIsFakeNet = false;
 bool fCriminals = false;
@@ -1671,6 +1674,16 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
         return DISCONNECT_FAILED;
     }
 
+    // rewards settled by the block
+    if (paccountHistoryDB) {
+        paccountHistoryDB->EraseRewardHistory(pindex->nHeight);
+    }
+
+    // pools created by the block still exist
+    if (ppoolHistoryDB) {
+        ppoolHistoryDB->EraseBlockHistory(mnview, pindex->nHeight);
+    }
+
     // special case: possible undo (first) of custom 'complex changes' for the whole block (expired orders and/or prices)
     mnview.OnUndoTx(uint256(), (uint32_t) pindex->nHeight); // undo for "zero hash"
 
@@ -2389,6 +2402,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     // it's used for account changes by the block
     // to calculate their merkle root in isolation
     CCustomCSView accountsView(mnview);
+    // swaps of the block for -poolhistoryindex
+    PoolSwapVolumes poolSwapVolumes;
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
     std::vector<PrecomputedTransactionData> txdata;
     txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
@@ -2462,6 +2477,9 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             }
 
             const auto res = ApplyCustomTx(accountsView, view, tx, chainparams.GetConsensus(), pindex->nHeight, pindex->GetBlockTime(), i, paccountHistoryDB.get(), pburnHistoryDB.get());
+            if (res.ok && ppoolHistoryDB) {
+                AddPoolSwapVolume(accountsView, tx, pindex->nHeight, poolSwapVolumes);
+            }
             if (!res.ok && (res.code & CustomTxErrCodes::Fatal)) {
                 if (pindex->nHeight >= chainparams.GetConsensus().EunosHeight) {
                     return state.Invalid(ValidationInvalidReason::CONSENSUS,
@@ -2602,7 +2620,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     { // old data pruning and other (some processing made for the whole block)
         // make all changes to the new cache/snapshot to make it possible to take a diff later:
-        CCustomCSView cache(mnview);
+        CRewardsHistoryWriter cache(mnview, pindex->nHeight, paccountHistoryDB.get());
 
         // Hard coded LP_DAILY_DFI_REWARD change
         if (pindex->nHeight >= chainparams.GetConsensus().EunosHeight)
@@ -2894,6 +2912,10 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         pburnHistoryDB->WriteAccountHistory(entries.first, entries.second);
     }
 
+    if (ppoolHistoryDB) {
+        ppoolHistoryDB->WriteBlockHistory(mnview, pindex->nHeight, poolSwapVolumes);
+    }
+
     if (!fIsFakeNet) {
         mnview.IncrementMintedBy(minterKey);
 
@@ -3026,8 +3048,19 @@ bool CChainState::FlushStateToDisk(
         bool fMemoryCacheLarge = fDoFullFlush || (mode == FlushStateMode::IF_NEEDED && pcustomcsview->SizeEstimate() > memoryCacheSizeMax);
         // Flush best chain related state. This can only be done if the blocks / block index write was also done.
         if (fMemoryCacheLarge && !CoinsTip().GetBestBlock().IsNull()) {
+            // Mark the state with the block it's flushed at, checked on startup
+            auto epoch = pcustomcsview->GetFlushEpoch().value_or(CFlushEpoch{});
+            epoch.epoch++;
+            epoch.blockHash = CoinsTip().GetBestBlock();
+            pcustomcsview->SetFlushEpoch(epoch);
             // Flush view first to estimate size on disk later
-            if (!pcustomcsview->Flush()) {
+            const bool fAsyncFlush = fCustomAsyncFlush && !fDoFullFlush;
+            if (fAsyncFlush) {
+                // the changes are written in background, next blocks go to fresh layer
+                if (!pcustomcsDB->FlushAsync(pcustomcsview->GetStorage().Detach())) {
+                    return AbortNode(state, "Failed to write to masternode db to disk");
+                }
+            } else if (!pcustomcsview->Flush()) {
                 return AbortNode(state, "Failed to write db batch");
             }
             // Typical Coin structures on disk are around 48 bytes in size.
@@ -3039,7 +3072,7 @@ bool CChainState::FlushStateToDisk(
                 return AbortNode(state, "Disk space is too low!", _("Error: Disk space is too low!").translated, CClientUIInterface::MSG_NOPREFIX);
             }
             // Flush the chainstate (which may refer to block index entries).
-            if (!CoinsTip().Flush() || !pcustomcsDB->Flush()) {
+            if (!CoinsTip().Flush() || (!fAsyncFlush && !pcustomcsDB->Flush())) {
                 return AbortNode(state, "Failed to write to coin or masternode db to disk");
             }
             nLastFlush = nNow;
@@ -3186,9 +3219,15 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
             if (pburnHistoryDB) {
                 pburnHistoryDB->Discard();
             }
+            if (ppoolHistoryDB) {
+                ppoolHistoryDB->Discard();
+            }
             m_disconnectTip = false;
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         }
+        if (ppoolProviders) {
+            ppoolProviders->ApplyChanges(mnview);
+        }
         bool flushed = view.Flush() && mnview.Flush();
         assert(flushed);
 
@@ -3199,6 +3238,9 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
         if (pburnHistoryDB) {
             pburnHistoryDB->Flush();
         }
+        if (ppoolHistoryDB) {
+            ppoolHistoryDB->Flush();
+        }
 
         if (!disconnectedConfirms.empty()) {
             for (auto const & confirm : disconnectedConfirms) {
@@ -3355,10 +3397,16 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
             if (pburnHistoryDB) {
                 pburnHistoryDB->Discard();
             }
+            if (ppoolHistoryDB) {
+                ppoolHistoryDB->Discard();
+            }
             return error("%s: ConnectBlock %s failed, %s", __func__, pindexNew->GetBlockHash().ToString(), FormatStateMessage(state));
         }
         nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
         LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
+        if (ppoolProviders) {
+            ppoolProviders->ApplyChanges(mnview);
+        }
         bool flushed = view.Flush() && mnview.Flush();
         assert(flushed);
 
@@ -3369,6 +3417,9 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
         if (pburnHistoryDB) {
             pburnHistoryDB->Flush();
         }
+        if (ppoolHistoryDB) {
+            ppoolHistoryDB->Flush();
+        }
 
         // anchor rewards re-voting etc...
         if (!rewardedAnchors.empty()) {
@@ -9,6 +9,7 @@ from test_framework.test_framework import DefiTestFramework
 
 from test_framework.util import (
     assert_equal,
+    assert_raises_rpc_error,
     connect_nodes_bi
 )
 
@@ -72,6 +73,17 @@ class TokensRPCListAccountHistory(DefiTestFramework):
         for txs in results:
             assert(hasattr(txs['amounts'], '__len__') and (not isinstance(txs['amounts'], str)))
 
+        # Continue from the key of an account record, wallet outputs have no keys
+        history = [txs for txs in results if 'key' in txs]
+        assert_equal(self.nodes[0].listaccounthistory(collateral_a, {'start': history[0]['key'], 'including_start': True}), history)
+        assert_equal(self.nodes[0].listaccounthistory(collateral_a, {'start': history[-1]['key']}), [])
+        # heights and txns of a key are stored inverted, the key of height 0 and txn 0 is the last one of the owner
+        owner_key = history[0]['key'][:-16]
+        assert_equal(self.nodes[0].listaccounthistory(collateral_a, {'start': owner_key + 'ff' * 8}), [])
+        height = self.nodes[0].getblockcount()
+        assert_raises_rpc_error(-8, "start key height is above maxBlockHeight", self.nodes[0].listaccounthistory, collateral_a, {'start': owner_key + format(~(height + 1) & 0xffffffff, '08x') + 'ff' * 4})
+        assert_raises_rpc_error(-8, "start key height is above maxBlockHeight", self.nodes[0].listaccounthistory, collateral_a, {'start': history[0]['key'], 'maxBlockHeight': history[0]['blockHeight'] - 1})
+
         # Get node 1 results
         results = self.nodes[1].listaccounthistory(collateral_a)
 
@@ -107,5 +119,25 @@ class TokensRPCListAccountHistory(DefiTestFramework):
         assert_equal(len(results), 0)
         assert_equal(self.nodes[1].accounthistorycount(collateral_a), 0)
 
+        # History of wallet owners is merged by height and txn, a limit takes the latest rows of all owners
+        collateral_b = self.nodes[0].getnewaddress("", "legacy")
+        self.nodes[0].minttokens(["300@" + token_a])
+        self.nodes[0].sendtoaddress(collateral_b, 1)
+        self.nodes[0].generate(1)
+        self.nodes[0].accounttoaccount(collateral_a, {collateral_b: "10@" + token_a})
+        self.nodes[0].generate(1)
+        self.nodes[0].accounttoaccount(collateral_a, {collateral_b: "10@" + token_a})
+        self.nodes[0].accounttoaccount(collateral_b, {collateral_a: "5@" + token_a})
+        self.nodes[0].generate(1)
+
+        symbol_key = self.nodes[0].gettoken(token_a)[token_a]['symbolKey']
+        results = self.nodes[0].listaccounthistory('mine', {'token': symbol_key})
+        assert_equal(len(results), 7)
+        assert_equal(set(txs['owner'] for txs in results), {collateral_a, collateral_b})
+        keys = [(txs['blockHeight'], txs['txn']) for txs in results]
+        assert_equal(keys, sorted(keys, reverse=True))
+        for limit in range(1, len(results) + 1):
+            assert_equal(self.nodes[0].listaccounthistory('mine', {'token': symbol_key, 'limit': limit}), results[:limit])
+
 if __name__ == '__main__':
     TokensRPCListAccountHistory().main ()